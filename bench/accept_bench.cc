@@ -0,0 +1,143 @@
+// accept吞吐: 短连接 服务端连接一建立就shutdown 客户端读到EOF后RST关闭 对比
+//   single:   baseloop一个Acceptor accept 轮询交给IO loop(每个连接一次跨线程交接)
+//   perloop:  kReusePortPerLoop 每个IO loop自己一个SO_REUSEPORT监听socket 内核按hash分
+//   perloop-cpu: 同上 挂CBPF按处理SYN的CPU选loop
+// 统计服务端每秒建立的连接数 以及每个loop分到的连接数的最大/最小值
+// 客户端等服务端处理完才发起下一个连接 否则单核机器上accept线程被抢占时全连接队列会溢出 SYN要等1秒重传 结果全是噪声
+// 用法: ./accept_bench [客户端线程数 默认4] [每项秒数 默认1] [最多IO loop数 默认16]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19991;
+
+static std::atomic<int64_t> g_established(0);
+static std::mutex g_mutex;
+static std::map<EventLoop *, int64_t> g_perLoop;
+
+static void runClient(double seconds)
+{
+    InetAddress addr(kPort);
+    char buf[64];
+    struct linger lingerOpt = {1, 0};
+    MonotonicTime end(addTime(MonotonicTime::now(), seconds));
+    while (MonotonicTime::now() < end)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+        {
+            ::close(fd);
+            continue;
+        }
+        while (::read(fd, buf, sizeof buf) > 0)
+        {
+        }
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lingerOpt, sizeof lingerOpt);
+        ::close(fd);
+    }
+}
+
+static void run(EventLoop *baseLoop, const char *label, TcpServer::Option option, TcpServer::AcceptSteering steering,
+                int loops, int clients, double seconds)
+{
+    g_established.store(0);
+    g_perLoop.clear();
+    TcpServer *server = nullptr;
+    std::promise<void> started;
+    baseLoop->runInLoop([&]() {
+        server = new TcpServer(baseLoop, InetAddress(kPort), "accept", option);
+        server->setThreadNum(loops);
+        server->setAcceptSteering(steering);
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                g_established.fetch_add(1, std::memory_order_relaxed);
+                {
+                    std::lock_guard<std::mutex> lock(g_mutex);
+                    ++g_perLoop[conn->getLoop()];
+                }
+                conn->shutdown();
+            }
+        });
+        server->start();
+        started.set_value();
+    });
+    started.get_future().wait();
+    ::usleep(20 * 1000);
+
+    MonotonicTime start(MonotonicTime::now());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i)
+    {
+        threads.emplace_back(runClient, seconds);
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    double elapsed = timeDifference(MonotonicTime::now(), start);
+    ::usleep(20 * 1000);
+
+    int64_t minPerLoop = 0;
+    int64_t maxPerLoop = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (static_cast<int>(g_perLoop.size()) == loops)
+        {
+            minPerLoop = INT64_MAX;
+            for (const auto &item : g_perLoop)
+            {
+                minPerLoop = std::min(minPerLoop, item.second);
+                maxPerLoop = std::max(maxPerLoop, item.second);
+            }
+        }
+        else
+        {
+            for (const auto &item : g_perLoop)
+            {
+                maxPerLoop = std::max(maxPerLoop, item.second);
+            }
+        }
+    }
+    printf("%-11s %2d loops  %8.0f accepts/s  per loop min %6lld max %6lld\n", label, loops,
+           g_established.load() / elapsed, static_cast<long long>(minPerLoop), static_cast<long long>(maxPerLoop));
+
+    std::promise<void> stopped;
+    baseLoop->runInLoop([&]() {
+        delete server;
+        stopped.set_value();
+    });
+    stopped.get_future().wait();
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 4;
+    double seconds = argc > 2 ? atof(argv[2]) : 1;
+    int maxLoops = argc > 3 ? atoi(argv[3]) : 16;
+
+    Logger::setLogLevel(FATAL); // 客户端用RST关闭 服务端每个连接都会打一条ECONNRESET的ERROR
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+
+    for (int loops = 1; loops <= maxLoops; loops *= 2)
+    {
+        run(baseLoop, "single", TcpServer::kNoReusePort, TcpServer::kHashSteering, loops, clients, seconds);
+        run(baseLoop, "perloop", TcpServer::kReusePortPerLoop, TcpServer::kHashSteering, loops, clients, seconds);
+        run(baseLoop, "perloop-cpu", TcpServer::kReusePortPerLoop, TcpServer::kCpuSteering, loops, clients, seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// 内存分配次数统计: 一个连接从建立到销毁 / 一次跨线程send 各要多少次operator new
+// 用法: ./alloc_bench [连接次数 默认2000] [跨线程send次数 默认100000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19983;
+
+static std::atomic<int64_t> g_allocations(0);
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = ::malloc(size ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept { ::free(p); }
+void operator delete(void *p, size_t) noexcept { ::free(p); }
+
+static std::atomic<int> g_connected(0);
+static std::atomic<int> g_disconnected(0);
+static TcpConnectionPtr g_conn; // 第二阶段用 loop线程写 g_connected同步后客户端线程读
+
+static int connectServer()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        perror("connect");
+        ::exit(1);
+    }
+    return fd;
+}
+
+static void waitFor(const std::atomic<int> &counter, int value)
+{
+    while (counter.load(std::memory_order_acquire) < value)
+    {
+        std::this_thread::yield();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 2000;
+    int sends = argc > 2 ? atoi(argv[2]) : 100000;
+
+    Logger::setLogLevel(WARN);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "alloc");
+    server.setThreadNum(1);
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            g_conn = conn;
+            g_connected.fetch_add(1, std::memory_order_release);
+        }
+        else
+        {
+            g_conn.reset();
+            g_disconnected.fetch_add(1, std::memory_order_release);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+
+    std::thread client([&]() {
+        // 预热一次 让各种一次性的初始化不算进去
+        ::close(connectServer());
+        waitFor(g_disconnected, 1);
+
+        // 阶段一: 连接建立 -> 断开 -> TcpConnection析构
+        int64_t before = g_allocations.load();
+        for (int i = 0; i < connections; ++i)
+        {
+            ::close(connectServer());
+            waitFor(g_disconnected, i + 2);
+        }
+        int64_t lifecycle = g_allocations.load() - before;
+        printf("connection lifecycle: %d connections %10ld allocations  %.2f per connection\n",
+               connections, lifecycle, static_cast<double>(lifecycle) / connections);
+
+        // 阶段二: 在非IO线程上调用send 数据要转到IO线程发送
+        int fd = connectServer();
+        waitFor(g_connected, connections + 2);
+        TcpConnectionPtr conn = g_conn;
+        std::thread reader([fd]() {
+            char buf[65536];
+            while (::read(fd, buf, sizeof buf) > 0)
+            {
+            }
+        });
+        static const std::string msg(64, 'x'); // 跨线程send会拷贝一份
+        for (int i = 0; i < 1000; ++i)
+        {
+            conn->send(msg);
+        }
+        before = g_allocations.load();
+        for (int i = 0; i < sends; ++i)
+        {
+            conn->send(msg);
+        }
+        int64_t sendAllocations = g_allocations.load() - before;
+        printf("cross-thread send:    %d sends       %10ld allocations  %.2f per send\n",
+               sends, sendAllocations, static_cast<double>(sendAllocations) / sends);
+
+        conn->shutdown();
+        conn.reset();
+        reader.join();
+        ::close(fd);
+        loop.runInLoop([&loop]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,301 @@
+// 负载不均时选loop策略对尾延迟的影响
+// 先建16个长连接 建立时看不出轻重 各策略都会大致均分 之后落在loop 0上的那些变成重连接
+// (每20ms流水线发一批请求 服务端每个请求忙等一段时间) 其余的不发数据 于是连接数一样但loop 0负载高
+// 然后再建16个ping连接 每隔2ms发一个小请求 统计往返延迟 看哪些策略能避开loop 0
+// 每个客户端连接绑定不同的127.x.x.x源地址 一致性hash才分得开
+// 用法: ./balance_bench [IO loop数 默认4] [每种策略ping秒数 默认2] [重请求耗时us 默认100]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19992;
+static const int kBackground = 16;
+static const int kPings = 16;
+static const int kHeavyDepth = 16;
+static const int kHeavyIntervalUs = 20 * 1000;
+static const size_t kMessageSize = 16;
+
+static int64_t g_heavyMicroSeconds = 100;
+static std::atomic<bool> g_running(false);
+static std::atomic<bool> g_pingPhase(false);
+static std::atomic<int64_t> g_heavyRequests(0);
+static std::mutex g_mutex;
+static std::vector<EventLoop *> g_loops; // 和线程池里的顺序一致
+static std::vector<int> g_pingsPerLoop;
+static std::atomic<int> g_heavyConnections(0);
+
+static const char *kSelectionNames[] = {"round-robin", "least-conn", "p2c", "hash"};
+
+static bool writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::read(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 从127.0.net.host连过去
+// 返回服务端告知的loop下标 出错返回-1
+static int connectFrom(int net, int host, int *loopIndex)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in local;
+    ::memset(&local, 0, sizeof local);
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl((127U << 24) | (net << 8) | host);
+    InetAddress addr(kPort);
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&local), sizeof local) < 0 ||
+        ::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        perror("connect");
+        ::close(fd);
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    char greeting;
+    if (!readAll(fd, &greeting, 1))
+    {
+        ::close(fd);
+        return -1;
+    }
+    *loopIndex = greeting - '0';
+    return fd;
+}
+
+static void runHeavy(int fd)
+{
+    std::vector<char> requests(kHeavyDepth * kMessageSize, 'h');
+    std::vector<char> responses(requests.size());
+    while (g_running.load())
+    {
+        if (!writeAll(fd, requests.data(), requests.size()) || !readAll(fd, responses.data(), responses.size()))
+        {
+            break;
+        }
+        g_heavyRequests.fetch_add(kHeavyDepth);
+        ::usleep(kHeavyIntervalUs);
+    }
+    ::close(fd);
+}
+
+static void runPing(int fd, std::vector<int64_t> *rtts)
+{
+    char request[kMessageSize];
+    char response[kMessageSize];
+    ::memset(request, 'p', sizeof request);
+    while (g_running.load())
+    {
+        MonotonicTime start(MonotonicTime::now());
+        if (!writeAll(fd, request, sizeof request) || !readAll(fd, response, sizeof response))
+        {
+            break;
+        }
+        rtts->push_back(MonotonicTime::now().microSeconds() - start.microSeconds());
+        ::usleep(2000);
+    }
+    ::close(fd);
+}
+
+static int loopIndex(EventLoop *loop)
+{
+    return static_cast<int>(std::find(g_loops.begin(), g_loops.end(), loop) - g_loops.begin());
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    while (buf->readableBytes() >= kMessageSize)
+    {
+        if (*buf->peek() == 'h')
+        {
+            MonotonicTime end(MonotonicTime::now().microSeconds() + g_heavyMicroSeconds);
+            while (MonotonicTime::now() < end)
+            {
+            }
+        }
+        conn->send(buf->peek(), kMessageSize);
+        buf->retrieve(kMessageSize);
+    }
+}
+
+static void run(EventLoop *baseLoop, EventLoopThreadPool::LoopSelection selection, int loops, double seconds)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_loops.clear();
+        g_pingsPerLoop.assign(loops, 0);
+    }
+    g_pingPhase.store(false);
+    TcpServer *server = nullptr;
+    std::promise<void> started;
+    baseLoop->runInLoop([&]() {
+        server = new TcpServer(baseLoop, InetAddress(kPort), "balance");
+        server->setThreadNum(loops);
+        server->setLoopSelection(selection);
+        server->setThreadInitCallback([](EventLoop *loop) {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_loops.push_back(loop);
+        });
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (!conn->connected())
+            {
+                return;
+            }
+            conn->setTcpNoDelay(true);
+            // 告诉客户端它落在哪个loop上
+            int index = 0;
+            {
+                std::lock_guard<std::mutex> lock(g_mutex);
+                index = loopIndex(conn->getLoop());
+            }
+            char greeting = static_cast<char>('0' + index);
+            conn->send(&greeting, 1);
+            if (g_pingPhase.load())
+            {
+                std::lock_guard<std::mutex> lock(g_mutex);
+                ++g_pingsPerLoop[loopIndex(conn->getLoop())];
+            }
+        });
+        server->setMessageCallback(onMessage);
+        server->start();
+        started.set_value();
+    });
+    started.get_future().wait();
+
+    // 第一批长连接 落在loop 0上的变重
+    g_running.store(true);
+    g_heavyConnections.store(0);
+    std::vector<std::thread> threads;
+    std::vector<int> idleFds;
+    for (int i = 0; i < kBackground; ++i)
+    {
+        int index = 0;
+        int fd = connectFrom(0, i + 1, &index);
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (index == 0)
+        {
+            g_heavyConnections.fetch_add(1);
+            threads.emplace_back(runHeavy, fd);
+        }
+        else
+        {
+            idleFds.push_back(fd);
+        }
+    }
+    ::usleep(300 * 1000); // 让负载采样看到loop 0忙
+
+    g_pingPhase.store(true);
+    g_heavyRequests.store(0);
+    MonotonicTime start(MonotonicTime::now());
+    std::vector<std::vector<int64_t>> rtts(kPings);
+    std::vector<int> pingFds;
+    for (int i = 0; i < kPings; ++i)
+    {
+        int index = 0;
+        pingFds.push_back(connectFrom(1, i + 1, &index));
+        ::usleep(1000);
+    }
+    for (int i = 0; i < kPings; ++i)
+    {
+        if (pingFds[i] >= 0)
+        {
+            threads.emplace_back(runPing, pingFds[i], &rtts[i]);
+        }
+    }
+    ::usleep(static_cast<useconds_t>(seconds * 1e6));
+    g_running.store(false);
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    double elapsed = timeDifference(MonotonicTime::now(), start);
+    for (int fd : idleFds)
+    {
+        ::close(fd);
+    }
+
+    std::vector<int64_t> all;
+    for (const std::vector<int64_t> &v : rtts)
+    {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) -> long long {
+        return all.empty() ? 0 : static_cast<long long>(all[std::min(all.size() - 1, static_cast<size_t>(all.size() * p))]);
+    };
+    std::string pings;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (int n : g_pingsPerLoop)
+        {
+            pings += std::to_string(n) + " ";
+        }
+    }
+    printf("%-11s  %d heavy conns on loop 0 %6.0f req/s  %6zu pings  rtt us p50 %6lld p99 %6lld p999 %6lld max %6lld  pings per loop [ %s]\n",
+           kSelectionNames[selection], g_heavyConnections.load(), g_heavyRequests.load() / elapsed, all.size(), percentile(0.5), percentile(0.99),
+           percentile(0.999), all.empty() ? 0LL : static_cast<long long>(all.back()), pings.c_str());
+
+    std::promise<void> stopped;
+    baseLoop->runInLoop([&]() {
+        delete server;
+        stopped.set_value();
+    });
+    stopped.get_future().wait();
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 4;
+    double seconds = argc > 2 ? atof(argv[2]) : 2;
+    g_heavyMicroSeconds = argc > 3 ? atoi(argv[3]) : 100;
+
+    Logger::setLogLevel(WARN);
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+
+    for (int selection = EventLoopThreadPool::kRoundRobin; selection <= EventLoopThreadPool::kConsistentHash; ++selection)
+    {
+        run(baseLoop, static_cast<EventLoopThreadPool::LoopSelection>(selection), loops, seconds);
+    }
+    return 0;
+}
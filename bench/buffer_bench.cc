@@ -0,0 +1,90 @@
+// 发送缓冲区性能测试: Buffer(一整块vector) 对比 ChainBuffer(slab链 + writev)
+// 模拟outputBuffer_: 不断追加payload 非阻塞socket能写多少写多少 对端一个线程一直读
+// 用法: ./buffer_bench [每种大小发送的总MiB 默认512]
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <string>
+#include <thread>
+
+#include "Buffer.h"
+#include "ChainBuffer.h"
+#include "Timestamp.h"
+
+template <typename BufferType>
+static void run(const char *name, size_t payloadSize, size_t total)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        perror("socketpair");
+        ::exit(1);
+    }
+    ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    std::thread reader([fd = fds[1]]() {
+        static char buf[256 * 1024];
+        while (::read(fd, buf, sizeof buf) > 0)
+        {
+        }
+    });
+
+    // 对端读得慢时最多攒这么多没发出去的数据
+    const size_t maxPending = std::max<size_t>(4 * 1024 * 1024, payloadSize * 2);
+    std::string payload(payloadSize, 'x');
+    BufferType buffer;
+    size_t produced = 0;
+    size_t sent = 0;
+    int64_t writes = 0;
+    MonotonicTime start(MonotonicTime::now());
+    while (sent < total)
+    {
+        if (produced < total && buffer.readableBytes() < maxPending)
+        {
+            buffer.append(payload.data(), payloadSize);
+            produced += payloadSize;
+            // 小消息攒一点再写 和一轮事件里回调多次send的情况差不多
+            if (buffer.readableBytes() < 64 * 1024 && produced < total)
+            {
+                continue;
+            }
+        }
+        int savedErrno = 0;
+        ssize_t n = buffer.writeFd(fds[0], &savedErrno);
+        ++writes;
+        if (n > 0)
+        {
+            buffer.retrieve(n);
+            sent += n;
+        }
+        else if (savedErrno == EAGAIN && (produced == total || buffer.readableBytes() >= maxPending))
+        {
+            struct pollfd pfd = {fds[0], POLLOUT, 0};
+            ::poll(&pfd, 1, -1);
+        }
+    }
+    double seconds = timeDifference(MonotonicTime::now(), start);
+    ::close(fds[0]);
+    reader.join();
+    ::close(fds[1]);
+
+    printf("%-12s payload %9zu B  %8.1f MiB/s  %8ld writes  %.1f KiB/write\n",
+           name, payloadSize, total / seconds / (1024 * 1024), writes,
+           static_cast<double>(total) / writes / 1024);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t total = static_cast<size_t>(argc > 1 ? atoi(argv[1]) : 512) * 1024 * 1024;
+    const size_t sizes[] = {1024, 64 * 1024, 16 * 1024 * 1024};
+    for (size_t size : sizes)
+    {
+        size_t rounded = total / size * size;
+        run<Buffer>("Buffer", size, rounded);
+        run<ChainBuffer>("ChainBuffer", size, rounded);
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Buffer内存池长时间运行测试: 大量连接 轮流有一部分连接突发大消息 看常驻内存能不能降回来
+// 用法: ./buffer_soak_bench [连接数 默认100000] [突发消息字节 默认65536] [轮数 默认5] [每轮突发的连接比例 默认10(%)]
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "BufferPool.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19984;
+
+static std::atomic<int> g_connected(0);
+static std::atomic<int64_t> g_messages(0);
+
+static long residentKiB()
+{
+    long pages = 0, resident = 0;
+    FILE *fp = ::fopen("/proc/self/statm", "r");
+    if (fp)
+    {
+        if (::fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        ::fclose(fp);
+    }
+    return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// 在loop线程里取池子的统计 等它返回
+static BufferPool::Stats poolStats(EventLoop *loop)
+{
+    BufferPool::Stats stats;
+    std::atomic_bool done(false);
+    loop->runInLoop([&]() {
+        stats = loop->bufferPool()->stats();
+        done.store(true, std::memory_order_release);
+    });
+    while (!done.load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+    return stats;
+}
+
+static void report(const char *phase, EventLoop *loop)
+{
+    BufferPool::Stats s = poolStats(loop);
+    long rss = residentKiB();
+    ::malloc_trim(0);
+    printf("%-16s rss %8ld KiB (after malloc_trim %8ld KiB)  pool in use %7ld blocks %8ld KiB  cached %5ld blocks %6ld KiB  hit %.1f%%\n",
+           phase, rss, residentKiB(), s.blocksInUse, s.bytesInUse / 1024, s.cachedBlocks, s.cachedBytes / 1024,
+           s.allocations ? 100.0 * s.hits / s.allocations : 0.0);
+}
+
+static int connectTo(int index)
+{
+    // 一个目的地址的临时端口不够10万个 轮流连127.0.0.x
+    char ip[32];
+    snprintf(ip, sizeof ip, "127.0.0.%d", 1 + index / 20000);
+    InetAddress addr(kPort, ip);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        perror("connect");
+        ::exit(1);
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 100000;
+    size_t burst = argc > 2 ? atoi(argv[2]) : 65536;
+    int rounds = argc > 3 ? atoi(argv[3]) : 5;
+    int percent = argc > 4 ? atoi(argv[4]) : 10;
+
+    // 客户端和服务端在一个进程里 每个连接两个fd
+    struct rlimit rl;
+    rl.rlim_cur = rl.rlim_max = connections * 2 + 1024;
+    if (::setrlimit(RLIMIT_NOFILE, &rl) < 0)
+    {
+        ::getrlimit(RLIMIT_NOFILE, &rl);
+        connections = std::min<int>(connections, (rl.rlim_cur - 1024) / 2);
+        printf("RLIMIT_NOFILE too low, using %d connections\n", connections);
+    }
+
+    Logger::setLogLevel(WARN);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort, "0.0.0.0"), "soak");
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            g_connected.fetch_add(1, std::memory_order_release);
+        }
+    });
+    // 模拟按消息解析: 整条消息收齐才取走
+    server.setMessageCallback([burst](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+        if (buf->readableBytes() >= burst)
+        {
+            buf->retrieveAll();
+            g_messages.fetch_add(1, std::memory_order_release);
+        }
+    });
+    server.start();
+
+    std::thread client([&]() {
+        std::vector<int> fds;
+        fds.reserve(connections);
+        for (int i = 0; i < connections; ++i)
+        {
+            fds.push_back(connectTo(i));
+        }
+        while (g_connected.load(std::memory_order_acquire) < connections)
+        {
+            std::this_thread::yield();
+        }
+        printf("connections %d  burst %zu bytes  %d%% of connections per round\n", connections, burst, percent);
+        report("connected", &loop);
+
+        std::string payload(burst, 'x');
+        int64_t expected = 0;
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (int i = 0; i < connections; ++i)
+            {
+                if ((i + round * 7) % 100 < percent)
+                {
+                    size_t left = burst;
+                    while (left > 0)
+                    {
+                        ssize_t n = ::write(fds[i], payload.data() + (burst - left), left);
+                        if (n <= 0)
+                        {
+                            perror("write");
+                            ::exit(1);
+                        }
+                        left -= n;
+                    }
+                    ++expected;
+                }
+            }
+            while (g_messages.load(std::memory_order_acquire) < expected)
+            {
+                std::this_thread::yield();
+            }
+            char phase[32];
+            snprintf(phase, sizeof phase, "after burst %d", round + 1);
+            report(phase, &loop);
+        }
+
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        loop.runInLoop([&loop]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,185 @@
+// busy-poll: 单个连接pingpong(一个行情源) 看IO loop开/关busy-poll时往返延迟的p50/p99/p999
+//   off:       阻塞在epoll_wait里 每个消息都要睡下去再被唤醒
+//   spin:      每次先零超时poll自旋最多spin微秒
+//   adaptive:  同上 预算按空闲情况自动伸缩
+// 还统计IO loop的CPU 自旋命中/落空次数和阻塞唤醒次数
+// 用法: ./busypoll_bench [秒数 默认2] [消息字节 默认64] [发送间隔us 默认0] [自旋预算us 默认50]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19995;
+
+enum Mode { kOff, kSpin, kAdaptive };
+static const char *kModeNames[] = {"off", "spin", "adaptive"};
+
+static std::atomic<EventLoop *> g_ioLoop(nullptr);
+
+static bool writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::read(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static double loopCpuSeconds(EventLoop *loop)
+{
+    std::atomic<bool> done(false);
+    double seconds = 0;
+    loop->runInLoop([&]() {
+        struct rusage usage;
+        ::getrusage(RUSAGE_THREAD, &usage);
+        seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        done.store(true);
+    });
+    while (!done.load())
+    {
+        ::usleep(100);
+    }
+    return seconds;
+}
+
+static void run(EventLoop *baseLoop, Mode mode, double seconds, size_t msgSize, int gapUs, int64_t spinUs)
+{
+    g_ioLoop.store(nullptr);
+    TcpServer *server = nullptr;
+    std::promise<void> started;
+    baseLoop->runInLoop([&]() {
+        server = new TcpServer(baseLoop, InetAddress(kPort), "busypoll");
+        server->setThreadNum(1);
+        if (mode != kOff)
+        {
+            server->setBusyPoll(spinUs, mode == kAdaptive);
+        }
+        server->setThreadInitCallback([](EventLoop *loop) { g_ioLoop.store(loop); });
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            conn->send(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        });
+        server->start();
+        started.set_value();
+    });
+    started.get_future().wait();
+    EventLoop *ioLoop = g_ioLoop.load();
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        perror("connect");
+        return;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    ::usleep(50 * 1000);
+
+    std::string msg(msgSize, 'x');
+    std::string reply(msgSize, 0);
+    std::vector<int64_t> latencies;
+    double cpuStart = loopCpuSeconds(ioLoop);
+    EventLoop::BusyPollStats statsStart = ioLoop->busyPollStats();
+    MonotonicTime begin(MonotonicTime::now());
+    MonotonicTime end(addTime(begin, seconds));
+    for (;;)
+    {
+        MonotonicTime start(MonotonicTime::now());
+        if (end < start)
+        {
+            break;
+        }
+        if (!writeAll(fd, msg.data(), msgSize) || !readAll(fd, &reply[0], msgSize))
+        {
+            break;
+        }
+        latencies.push_back(MonotonicTime::now().microSeconds() - start.microSeconds());
+        if (gapUs > 0)
+        {
+            ::usleep(gapUs);
+        }
+    }
+    double elapsed = timeDifference(MonotonicTime::now(), begin);
+    EventLoop::BusyPollStats stats = ioLoop->busyPollStats();
+    double cpu = loopCpuSeconds(ioLoop) - cpuStart;
+    ::close(fd);
+
+    std::sort(latencies.begin(), latencies.end());
+    size_t n = std::max<size_t>(latencies.size(), 1);
+    auto percentile = [&latencies](double p) -> long long {
+        return latencies.empty() ? 0 : static_cast<long long>(latencies[std::min(latencies.size() - 1, static_cast<size_t>(latencies.size() * p))]);
+    };
+    printf("%-8s %7.0f rt/s  latency us p50 %4lld p99 %5lld p999 %5lld  io loop cpu %5.1f%%  "
+           "per rt: spin %5.1f us hits %4.2f misses %4.2f wakeups %4.2f  budget now %lld us\n",
+           kModeNames[mode], latencies.size() / elapsed, percentile(0.5), percentile(0.99), percentile(0.999),
+           cpu * 100 / elapsed, static_cast<double>(stats.spinMicroSeconds - statsStart.spinMicroSeconds) / n,
+           static_cast<double>(stats.spinHits - statsStart.spinHits) / n,
+           static_cast<double>(stats.spinMisses - statsStart.spinMisses) / n,
+           static_cast<double>(stats.wakeups - statsStart.wakeups) / n,
+           static_cast<long long>(stats.spinBudgetMicroSeconds));
+
+    std::promise<void> stopped;
+    baseLoop->runInLoop([&]() {
+        delete server;
+        stopped.set_value();
+    });
+    stopped.get_future().wait();
+    ::usleep(50 * 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2;
+    size_t msgSize = argc > 2 ? atoi(argv[2]) : 64;
+    int gapUs = argc > 3 ? atoi(argv[3]) : 0;
+    int64_t spinUs = argc > 4 ? atoi(argv[4]) : 50;
+
+    Logger::setLogLevel(WARN);
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    for (int mode = kOff; mode <= kAdaptive; ++mode)
+    {
+        run(baseLoop, static_cast<Mode>(mode), seconds, msgSize, gapUs, spinUs);
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Channel在Poller里的增删查: 先挂上N个常驻的channel 然后反复
+//   随机关掉一个(remove + close) -> 新开一个eventfd(内核复用最小的空闲fd) -> enableReading
+// 统计每次开关的耗时 以及对所有常驻channel做hasChannel的耗时
+// 用法: ./channel_churn_bench [开关次数 默认1000000] [常驻channel数 默认10000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <memory>
+#include <vector>
+
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+static long rssKiB()
+{
+    FILE *fp = ::fopen("/proc/self/status", "r");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    char line[128];
+    long value = 0;
+    while (::fgets(line, sizeof line, fp) != nullptr)
+    {
+        if (::sscanf(line, "VmRSS: %ld", &value) == 1)
+        {
+            break;
+        }
+    }
+    ::fclose(fp);
+    return value;
+}
+
+static std::unique_ptr<Channel> openChannel(EventLoop *loop)
+{
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("eventfd");
+        exit(1);
+    }
+    std::unique_ptr<Channel> channel(new Channel(loop, fd));
+    channel->enableReading();
+    return channel;
+}
+
+static void closeChannel(std::unique_ptr<Channel> *channel)
+{
+    int fd = (*channel)->fd();
+    (*channel)->disableAll();
+    (*channel)->remove();
+    channel->reset();
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    long cycles = argc > 1 ? atol(argv[1]) : 1000000;
+    int live = argc > 2 ? atoi(argv[2]) : 10000;
+
+    Logger::setLogLevel(WARN);
+    EventLoop loop; // 不跑loop() 只在本线程里操作它的Poller
+    long rssStart = rssKiB();
+
+    std::vector<std::unique_ptr<Channel>> channels;
+    for (int i = 0; i < live; ++i)
+    {
+        channels.push_back(openChannel(&loop));
+    }
+
+    uint64_t random = 88172645463325252ULL;
+    MonotonicTime start(MonotonicTime::now());
+    for (long i = 0; i < cycles; ++i)
+    {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        std::unique_ptr<Channel> &victim = channels[random % live];
+        closeChannel(&victim);
+        victim = openChannel(&loop);
+    }
+    double churnSeconds = timeDifference(MonotonicTime::now(), start);
+
+    const int kLookupRounds = 100;
+    int64_t found = 0;
+    start = MonotonicTime::now();
+    for (int round = 0; round < kLookupRounds; ++round)
+    {
+        for (const std::unique_ptr<Channel> &channel : channels)
+        {
+            found += loop.hasChannel(channel.get()) ? 1 : 0;
+        }
+    }
+    double lookupSeconds = timeDifference(MonotonicTime::now(), start);
+
+    printf("%ld open/close cycles with %d live channels  %7.1f ns/cycle  hasChannel %5.1f ns  found %lld/%lld  rss +%ld KiB\n",
+           cycles, live, churnSeconds * 1e9 / cycles, lookupSeconds * 1e9 / (static_cast<double>(kLookupRounds) * live),
+           static_cast<long long>(found), static_cast<long long>(kLookupRounds) * live, rssKiB() - rssStart);
+
+    for (std::unique_ptr<Channel> &channel : channels)
+    {
+        closeChannel(&channel);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+// 连接建立/断开的吞吐: 服务端连接一建立就shutdown 客户端读到EOF后用RST关闭(不留TIME_WAIT)
+// 每个连接都走完 accept -> 建立 -> 关闭 -> 销毁 的全过程
+// 吞吐受客户端connect/close的内核开销影响很大 另外统计服务端所有loop线程每个连接花的CPU
+// 用法: ./churn_bench [客户端线程数 默认4] [秒数 默认3] [IO线程数 默认2]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19990;
+
+static std::atomic<int64_t> g_established(0);
+static std::atomic<int64_t> g_destroyed(0);
+static std::mutex g_mutex;
+static std::vector<EventLoop *> g_loops; // 服务端所有loop线程
+
+// 在loop线程里取它自己的CPU时间
+static double loopCpuSeconds(EventLoop *loop)
+{
+    std::atomic<bool> done(false);
+    double seconds = 0;
+    loop->runInLoop([&]() {
+        struct rusage usage;
+        ::getrusage(RUSAGE_THREAD, &usage);
+        seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        done.store(true);
+    });
+    while (!done.load())
+    {
+        ::usleep(100);
+    }
+    return seconds;
+}
+
+static double serverCpuSeconds()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    double total = 0;
+    for (EventLoop *loop : g_loops)
+    {
+        total += loopCpuSeconds(loop);
+    }
+    return total;
+}
+
+static int64_t runClient(double seconds)
+{
+    InetAddress addr(kPort);
+    int64_t done = 0;
+    char buf[64];
+    struct linger lingerOpt = {1, 0};
+    MonotonicTime end(addTime(MonotonicTime::now(), seconds));
+    while (MonotonicTime::now() < end)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+        {
+            perror("connect");
+            ::close(fd);
+            break;
+        }
+        while (::read(fd, buf, sizeof buf) > 0)
+        {
+        }
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lingerOpt, sizeof lingerOpt);
+        ::close(fd);
+        ++done;
+    }
+    return done;
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 4;
+    double seconds = argc > 2 ? atof(argv[2]) : 3;
+    int ioThreads = argc > 3 ? atoi(argv[3]) : 2;
+
+    Logger::setLogLevel(FATAL); // 客户端用RST关闭 服务端每个连接都会打一条ECONNRESET的ERROR
+    EventLoopThread serverThread;
+    EventLoop *baseLoop = serverThread.startLoop();
+    TcpServer *server = nullptr;
+    baseLoop->runInLoop([&]() {
+        server = new TcpServer(baseLoop, InetAddress(kPort), "churn");
+        server->setThreadNum(ioThreads);
+        server->setThreadInitCallback([](EventLoop *loop) {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_loops.push_back(loop);
+        });
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                g_established.fetch_add(1);
+                conn->shutdown();
+            }
+            else
+            {
+                g_destroyed.fetch_add(1);
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+        server->start();
+    });
+    ::usleep(100 * 1000);
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (ioThreads > 0)
+        {
+            g_loops.push_back(baseLoop); // 只有0个IO线程时threadInitCallback才会拿到baseloop
+        }
+    }
+
+    double cpuStart = serverCpuSeconds();
+    double baseCpuStart = loopCpuSeconds(baseLoop);
+    std::atomic<int64_t> total(0);
+    MonotonicTime start(MonotonicTime::now());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i)
+    {
+        threads.emplace_back([&]() { total.fetch_add(runClient(seconds)); });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    double elapsed = timeDifference(MonotonicTime::now(), start);
+    // 等最后几个连接在服务端销毁完
+    for (int i = 0; i < 100 && g_destroyed.load() < g_established.load(); ++i)
+    {
+        ::usleep(10 * 1000);
+    }
+    double cpu = serverCpuSeconds() - cpuStart;
+    double baseCpu = loopCpuSeconds(baseLoop) - baseCpuStart;
+    printf("%d clients %d io threads  %8.0f connections/s  server cpu %5.2f us/conn (baseloop %5.2f)  established %lld destroyed %lld\n",
+           clients, ioThreads, total.load() / elapsed, cpu * 1e6 / total.load(), baseCpu * 1e6 / total.load(),
+           static_cast<long long>(g_established.load()), static_cast<long long>(g_destroyed.load()));
+
+    baseLoop->runInLoop([&]() { delete server; });
+    ::usleep(100 * 1000);
+    return 0;
+}
@@ -0,0 +1,195 @@
+// auto-cork: 流水线请求 每个响应分header/body/trailer三次send
+// 对比三种连接设置下IO线程每个请求的写系统调用数和吞吐
+//   nagle:     什么都不设 每次send一次write 小段被Nagle和延迟ACK卡住
+//   nodelay:   TCP_NODELAY 每次send一次write 一个小段
+//   auto-cork: TCP_NODELAY + auto-cork 一轮里一个连接的响应合并成一次writev
+// 写系统调用数取自IO线程的/proc/thread-self/io里的syscw
+// 用法: ./cork_bench [连接数 默认4] [流水线深度 默认16] [body字节 默认200] [秒数 默认3]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19988;
+static const size_t kRequestSize = 16;
+static const size_t kHeaderSize = 32;
+static const size_t kTrailerSize = 8;
+
+enum Mode { kNagle, kNoDelay, kAutoCork };
+static const char *kModeNames[] = {"nagle", "nodelay", "auto-cork"};
+static Mode g_mode = kNagle;
+static std::string g_header(kHeaderSize, 'h');
+static std::string g_body;
+static std::string g_trailer(kTrailerSize, 't');
+
+// 调用线程到目前为止的写系统调用数
+static int64_t threadWriteSyscalls()
+{
+    FILE *fp = ::fopen("/proc/thread-self/io", "r");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    char line[128];
+    long long value = 0;
+    while (::fgets(line, sizeof line, fp) != nullptr)
+    {
+        if (::sscanf(line, "syscw: %lld", &value) == 1)
+        {
+            break;
+        }
+    }
+    ::fclose(fp);
+    return value;
+}
+
+static int64_t loopWriteSyscalls(EventLoop *loop)
+{
+    std::atomic<bool> done(false);
+    int64_t value = 0;
+    loop->runInLoop([&]() {
+        value = threadWriteSyscalls();
+        done.store(true);
+    });
+    while (!done.load())
+    {
+        ::usleep(100);
+    }
+    return value;
+}
+
+static bool writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::read(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 一个连接: 一次写depth个请求 等depth个响应全部到齐再发下一批 返回完成的请求数
+static int64_t runClient(int depth, double seconds)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        perror("connect");
+        ::close(fd);
+        return 0;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+    const size_t responseSize = kHeaderSize + g_body.size() + kTrailerSize;
+    std::string requests(depth * kRequestSize, 'r');
+    std::string responses(depth * responseSize, 0);
+    int64_t done = 0;
+    MonotonicTime end(addTime(MonotonicTime::now(), seconds));
+    while (MonotonicTime::now() < end)
+    {
+        if (!writeAll(fd, requests.data(), requests.size()) || !readAll(fd, &responses[0], responses.size()))
+        {
+            break;
+        }
+        done += depth;
+    }
+    ::close(fd);
+    return done;
+}
+
+static void run(EventLoop *loop, int clients, int depth, double seconds)
+{
+    std::atomic<int64_t> requests(0);
+    int64_t writesStart = loopWriteSyscalls(loop);
+    MonotonicTime start(MonotonicTime::now());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i)
+    {
+        threads.emplace_back([&]() { requests.fetch_add(runClient(depth, seconds)); });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    double elapsed = timeDifference(MonotonicTime::now(), start);
+    int64_t writes = loopWriteSyscalls(loop) - writesStart;
+    printf("%-9s %d conns depth %2d  %9.0f req/s  %6.3f write syscalls/req\n", kModeNames[g_mode],
+           clients, depth, requests.load() / elapsed, static_cast<double>(writes) / requests.load());
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 4;
+    int depth = argc > 2 ? atoi(argv[2]) : 16;
+    g_body.assign(argc > 3 ? atoi(argv[3]) : 200, 'b');
+    double seconds = argc > 4 ? atof(argv[4]) : 3;
+
+    Logger::setLogLevel(WARN);
+    EventLoopThread serverThread;
+    EventLoop *ioLoop = serverThread.startLoop();
+    TcpServer *server = nullptr;
+    ioLoop->runInLoop([&]() {
+        server = new TcpServer(ioLoop, InetAddress(kPort), "cork");
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(g_mode != kNagle);
+                conn->setAutoCork(g_mode == kAutoCork);
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            while (buf->readableBytes() >= kRequestSize)
+            {
+                buf->retrieve(kRequestSize);
+                conn->send(g_header);
+                conn->send(g_body);
+                conn->send(g_trailer);
+            }
+        });
+        server->start();
+    });
+    ::usleep(100 * 1000);
+
+    for (int mode = kNagle; mode <= kAutoCork; ++mode)
+    {
+        g_mode = static_cast<Mode>(mode);
+        run(ioLoop, clients, depth, seconds);
+    }
+
+    ioLoop->runInLoop([&]() { delete server; });
+    ::usleep(100 * 1000);
+    return 0;
+}
@@ -0,0 +1,124 @@
+// LT / ET 模式下大块数据收发的系统调用次数对比
+// 服务端loop跑在主线程 统计这个线程的epoll_wait次数(loop轮数) 和read/write类系统调用次数(/proc/thread-self/io)
+// 用法: ./edge_trigger_bench [et 0/1 默认0] [upload/download 默认upload] [MiB 默认512]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <string>
+#include <thread>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19982;
+
+struct IoCounters
+{
+    long syscr; // read/readv等
+    long syscw; // write/writev等
+};
+
+static IoCounters readIoCounters()
+{
+    IoCounters counters = {0, 0};
+    FILE *fp = ::fopen("/proc/thread-self/io", "r");
+    if (fp)
+    {
+        char line[128];
+        while (::fgets(line, sizeof line, fp))
+        {
+            sscanf(line, "syscr: %ld", &counters.syscr);
+            sscanf(line, "syscw: %ld", &counters.syscw);
+        }
+        ::fclose(fp);
+    }
+    return counters;
+}
+
+int main(int argc, char *argv[])
+{
+    bool et = argc > 1 && atoi(argv[1]) != 0;
+    bool upload = argc <= 2 || strcmp(argv[2], "download") != 0;
+    size_t total = static_cast<size_t>(argc > 3 ? atoi(argv[3]) : 512) * 1024 * 1024;
+
+    Logger::setLogLevel(WARN);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "et_bench");
+    server.setEdgeTriggered(et, 1024 * 1024);
+
+    size_t received = 0;
+    long messages = 0;
+    int64_t startIteration = 0;
+    IoCounters startIo = {0, 0};
+    MonotonicTime start;
+
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            startIteration = loop.iteration();
+            startIo = readIoCounters();
+            start = MonotonicTime::now();
+            if (!upload)
+            {
+                conn->send(std::string(total, 'x'));
+                conn->shutdown();
+            }
+        }
+        else
+        {
+            double seconds = timeDifference(MonotonicTime::now(), start);
+            IoCounters io = readIoCounters();
+            long wakeups = static_cast<long>(loop.iteration() - startIteration);
+            long reads = io.syscr - startIo.syscr;
+            long writes = io.syscw - startIo.syscw;
+            double mib = total / (1024.0 * 1024.0);
+            printf("mode=%s %s %.0f MiB in %.3f s (%.1f MiB/s)\n", et ? "ET" : "LT",
+                   upload ? "upload" : "download", mib, seconds, mib / seconds);
+            printf("epoll_wait=%ld read-syscalls=%ld write-syscalls=%ld message-callbacks=%ld\n",
+                   wakeups, reads, writes, messages);
+            printf("syscalls per MiB: %.1f\n", (wakeups + reads + writes) / mib);
+            loop.quit();
+        }
+    });
+    server.setMessageCallback([&](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+        received += buf->readableBytes();
+        ++messages;
+        buf->retrieveAll();
+    });
+    server.start();
+
+    std::thread client([&]() {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        InetAddress addr(kPort);
+        if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+        {
+            perror("connect");
+            exit(1);
+        }
+        std::string chunk(1024 * 1024, 'x');
+        if (upload)
+        {
+            for (size_t sent = 0; sent < total;)
+            {
+                ssize_t n = ::write(fd, chunk.data(), std::min(chunk.size(), total - sent));
+                if (n <= 0)
+                {
+                    break;
+                }
+                sent += n;
+            }
+        }
+        else
+        {
+            while (::read(fd, &chunk[0], chunk.size()) > 0)
+            {
+            }
+        }
+        ::close(fd);
+    });
+    loop.loop();
+    client.join();
+    return 0;
+}
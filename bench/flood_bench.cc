@@ -0,0 +1,254 @@
+// 读端背压: 客户端尽全力灌数据 服务端按固定速率处理 看服务端积压的内存有没有上限
+//   watermark: 每轮回调按额度处理一部分 剩下的留在输入缓冲区 setInputWaterMarks自动暂停/恢复EPOLLIN
+//   stopread:  回调把数据全部交给工作线程 工作线程积压多了从IO线程stopRead 消化掉之后从工作线程startRead
+//   unbounded: 和watermark一样的处理方式 但不设水位 输入缓冲区一直涨
+// 用法: ./flood_bench [每种模式秒数 默认2] [处理速率MiB/s 默认64] [高水位KiB 默认4096] [低水位KiB 默认1024]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19989;
+static const int64_t kMaxFlood = 512LL * 1024 * 1024; // 每种模式客户端最多发这么多
+
+enum Mode { kWatermark, kStopRead, kUnbounded };
+static const char *kModeNames[] = {"watermark", "stopread", "unbounded"};
+
+static Mode g_mode = kWatermark;
+static size_t g_rate = 64 * 1024 * 1024;
+static size_t g_high = 4 * 1024 * 1024;
+static size_t g_low = 1024 * 1024;
+
+// 下面这些只在IO线程里访问
+static TcpConnectionPtr g_conn;
+static size_t g_credit = 0;
+static bool g_inputPaused = false;
+static int g_pauses = 0;
+
+static std::atomic<int64_t> g_consumed(0);
+static std::atomic<size_t> g_peak(0);
+
+// stopread模式的工作线程队列
+static std::mutex g_mutex;
+static std::deque<std::string> g_queue;
+static std::atomic<size_t> g_queued(0);
+static std::atomic<bool> g_stopped(false);
+static std::atomic<bool> g_workerRunning(false);
+
+static void updatePeak(size_t bytes)
+{
+    size_t peak = g_peak.load();
+    while (bytes > peak && !g_peak.compare_exchange_weak(peak, bytes))
+    {
+    }
+}
+
+static long rssKiB()
+{
+    FILE *fp = ::fopen("/proc/self/status", "r");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    char line[128];
+    long value = 0;
+    while (::fgets(line, sizeof line, fp) != nullptr)
+    {
+        if (::sscanf(line, "VmRSS: %ld", &value) == 1)
+        {
+            break;
+        }
+    }
+    ::fclose(fp);
+    return value;
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    if (g_mode == kStopRead)
+    {
+        size_t n = buf->readableBytes();
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_queue.push_back(buf->retrieveAllAsString());
+        }
+        size_t queued = g_queued.fetch_add(n) + n;
+        updatePeak(queued);
+        if (queued >= g_high && !g_stopped.exchange(true))
+        {
+            ++g_pauses;
+            conn->stopRead();
+        }
+        return;
+    }
+    size_t n = std::min(buf->readableBytes(), g_credit);
+    buf->retrieve(n);
+    g_credit -= n;
+    g_consumed.fetch_add(n);
+    updatePeak(buf->readableBytes());
+}
+
+// 工作线程: 每毫秒处理rate/1000字节 积压降到低水位就恢复读
+static void workerLoop()
+{
+    size_t perTick = g_rate / 1000;
+    while (g_workerRunning.load())
+    {
+        ::usleep(1000);
+        size_t budget = perTick;
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            while (budget > 0 && !g_queue.empty())
+            {
+                std::string &front = g_queue.front();
+                size_t n = std::min(budget, front.size());
+                front.erase(0, n);
+                budget -= n;
+                g_consumed.fetch_add(n);
+                if (front.empty())
+                {
+                    g_queue.pop_front();
+                }
+            }
+        }
+        size_t queued = g_queued.fetch_sub(perTick - budget) - (perTick - budget);
+        if (queued <= g_low && g_stopped.load())
+        {
+            TcpConnectionPtr conn;
+            {
+                std::lock_guard<std::mutex> lock(g_mutex);
+                conn = g_conn;
+            }
+            if (conn && g_stopped.exchange(false))
+            {
+                conn->startRead(); // 跨线程调用
+            }
+        }
+    }
+}
+
+static void run(EventLoop *loop, double seconds)
+{
+    g_consumed.store(0);
+    g_peak.store(0);
+    loop->runInLoop([]() { g_pauses = 0; });
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        perror("connect");
+        return;
+    }
+    struct timeval timeout = {0, 100 * 1000};
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout); // 被背压卡住时也能按时结束
+
+    static char block[64 * 1024];
+    int64_t sent = 0;
+    MonotonicTime start(MonotonicTime::now());
+    MonotonicTime end(addTime(start, seconds));
+    while (MonotonicTime::now() < end && sent < kMaxFlood)
+    {
+        ssize_t n = ::write(fd, block, sizeof block);
+        if (n > 0)
+        {
+            sent += n;
+        }
+    }
+    double elapsed = timeDifference(MonotonicTime::now(), start);
+    size_t peak = g_peak.load();
+    int64_t consumed = g_consumed.load();
+    long rss = rssKiB();
+    ::close(fd);
+
+    std::atomic<int> pauses(0);
+    std::atomic<bool> done(false);
+    loop->runInLoop([&]() {
+        pauses.store(g_pauses);
+        done.store(true);
+    });
+    while (!done.load())
+    {
+        ::usleep(100);
+    }
+    size_t limit = g_high + 1024 * 1024; // 高水位 + 到达高水位之前最后一次读的量
+    printf("%-9s sent %6.1f MiB  consumed %6.1f MiB (%5.1f MiB/s)  peak backlog %8.1f KiB  pauses %4d  rss %7ld KiB  %s\n",
+           kModeNames[g_mode], sent / 1048576.0, consumed / 1048576.0, consumed / 1048576.0 / elapsed,
+           peak / 1024.0, pauses.load(), rss, peak <= limit ? "bounded" : "UNBOUNDED");
+    ::usleep(200 * 1000); // 等服务端处理完关闭
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2;
+    g_rate = static_cast<size_t>(argc > 2 ? atoi(argv[2]) : 64) * 1024 * 1024;
+    g_high = static_cast<size_t>(argc > 3 ? atoi(argv[3]) : 4096) * 1024;
+    g_low = static_cast<size_t>(argc > 4 ? atoi(argv[4]) : 1024) * 1024;
+
+    Logger::setLogLevel(WARN);
+    EventLoopThread serverThread;
+    EventLoop *ioLoop = serverThread.startLoop();
+    TcpServer *server = nullptr;
+    ioLoop->runInLoop([&]() {
+        server = new TcpServer(ioLoop, InetAddress(kPort), "flood");
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            if (conn->connected())
+            {
+                g_conn = conn;
+                g_inputPaused = false;
+                if (g_mode == kWatermark)
+                {
+                    conn->setInputWaterMarks(
+                        g_high, g_low,
+                        [](const TcpConnectionPtr &, size_t) { g_inputPaused = true; ++g_pauses; },
+                        [](const TcpConnectionPtr &, size_t) { g_inputPaused = false; });
+                }
+            }
+            else
+            {
+                g_conn.reset();
+                g_queue.clear();
+                g_queued.store(0);
+                g_stopped.store(false);
+            }
+        });
+        server->setMessageCallback(onMessage);
+        server->start();
+        // 按速率发放处理额度 暂停期间用startRead把留在缓冲区里的数据再交给回调
+        ioLoop->runEvery(0.001, []() {
+            g_credit = std::min(g_credit + g_rate / 1000, g_rate / 100);
+            if (g_inputPaused && g_conn)
+            {
+                g_conn->startRead();
+            }
+        });
+    });
+    ::usleep(100 * 1000);
+
+    g_workerRunning.store(true);
+    std::thread worker(workerLoop);
+    for (int mode = kWatermark; mode <= kUnbounded; ++mode)
+    {
+        g_mode = static_cast<Mode>(mode);
+        run(ioLoop, seconds);
+    }
+    g_workerRunning.store(false);
+    worker.join();
+
+    ioLoop->runInLoop([&]() { delete server; });
+    ::usleep(100 * 1000);
+    return 0;
+}
@@ -0,0 +1,51 @@
+// 日志级别过滤的开销: 编译期去掉 / 运行时关闭 / 打开(输出丢弃) 三种情况每次调用的耗时
+// 用法: ./log_level_bench [调用次数 默认100000000]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Logger.h"
+#include "Timestamp.h"
+
+static void nullOutput(const char *, size_t)
+{
+}
+
+static void report(const char *what, long n, MonotonicTime start)
+{
+    double seconds = timeDifference(MonotonicTime::now(), start);
+    printf("%-22s %8.2f ns/call\n", what, seconds * 1e9 / n);
+}
+
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? atol(argv[1]) : 100000000L;
+    Logger::instance().setOutput(nullOutput);
+
+    // 默认编译下限是INFO LOG_DEBUG整句不生成代码
+    MonotonicTime start(MonotonicTime::now());
+    for (long i = 0; i < n; ++i)
+    {
+        LOG_DEBUG("compiled out %ld\n", i);
+    }
+    report("LOG_DEBUG compiled out", n, start);
+
+    // 运行时关闭: 只剩一次原子读和一次比较
+    Logger::setLogLevel(ERROR);
+    start = MonotonicTime::now();
+    for (long i = 0; i < n; ++i)
+    {
+        LOG_INFO("runtime disabled %ld\n", i);
+    }
+    report("LOG_INFO disabled", n, start);
+
+    // 打开: 完整格式化 输出函数直接丢弃
+    Logger::setLogLevel(INFO);
+    long enabledCalls = n / 100;
+    start = MonotonicTime::now();
+    for (long i = 0; i < enabledCalls; ++i)
+    {
+        LOG_INFO("enabled %ld\n", i);
+    }
+    report("LOG_INFO enabled", enabledCalls, start);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// 异步日志性能测试: N个线程同时打日志 统计每秒行数
+// 用法: ./logging_bench [线程数 默认4] [每个线程的行数 默认200000] [日志文件前缀 默认/tmp/logging_bench]
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <vector>
+
+#include "AsyncLogging.h"
+#include "Logger.h"
+#include "Thread.h"
+#include "Timestamp.h"
+
+static AsyncLogging *g_asyncLog = nullptr;
+
+static void asyncOutput(const char *msg, size_t len)
+{
+    g_asyncLog->append(msg, len);
+}
+
+int main(int argc, char *argv[])
+{
+    int numThreads = argc > 1 ? atoi(argv[1]) : 4;
+    int linesPerThread = argc > 2 ? atoi(argv[2]) : 200000;
+    const char *basename = argc > 3 ? argv[3] : "/tmp/logging_bench";
+
+    AsyncLogging log(basename, 512 * 1024 * 1024);
+    g_asyncLog = &log;
+    log.start();
+    Logger::instance().setOutput(asyncOutput);
+
+    MonotonicTime start(MonotonicTime::now());
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int i = 0; i < numThreads; ++i)
+    {
+        threads.emplace_back(new Thread([i, linesPerThread]() {
+            for (int n = 0; n < linesPerThread; ++n)
+            {
+                LOG_INFO("logging_bench thread %d line %d payload abcdefghijklmnopqrstuvwxyz\n", i, n);
+            }
+        }));
+        threads.back()->start();
+    }
+    for (std::unique_ptr<Thread> &t : threads)
+    {
+        t->join();
+    }
+    double frontend = timeDifference(MonotonicTime::now(), start);
+    log.stop();
+    double total = timeDifference(MonotonicTime::now(), start);
+
+    long lines = static_cast<long>(numThreads) * linesPerThread;
+    printf("threads=%d lines=%ld dropped=%lu\n", numThreads, lines, log.droppedLines());
+    printf("frontend %.3f s %12.0f lines/s\n", frontend, lines / frontend);
+    printf("on disk  %.3f s %12.0f lines/s\n", total, lines / total);
+    return 0;
+}
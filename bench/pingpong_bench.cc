@@ -0,0 +1,135 @@
+// pingpong/echo 性能测试: 服务端是TcpServer回显 客户端是N个阻塞线程 每个线程发一个消息等回显再发下一个
+// 用法: ./pingpong_bench [会话数 默认8] [消息大小 默认4096] [秒数 默认5] [IO线程数 默认1]
+// 对比后端: ./pingpong_bench 和 MUDUO_USE_IOURING=1 ./pingpong_bench
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19981;
+
+static bool writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::read(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 一个会话: 反复发msgSize字节 读回同样多的字节 记录每次往返的延迟(微秒)
+static void runSession(size_t msgSize, double seconds, std::vector<int64_t> *latencies)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        perror("connect");
+        return;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+    std::string msg(msgSize, 'x');
+    std::string reply(msgSize, 0);
+    MonotonicTime end(addTime(MonotonicTime::now(), seconds));
+    for (;;)
+    {
+        MonotonicTime start(MonotonicTime::now());
+        if (end < start)
+        {
+            break;
+        }
+        if (!writeAll(fd, msg.data(), msgSize) || !readAll(fd, &reply[0], msgSize))
+        {
+            break;
+        }
+        latencies->push_back(MonotonicTime::now().microSeconds() - start.microSeconds());
+    }
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    int sessions = argc > 1 ? atoi(argv[1]) : 8;
+    size_t msgSize = argc > 2 ? atoi(argv[2]) : 4096;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+    int ioThreads = argc > 4 ? atoi(argv[4]) : 1;
+
+    Logger::setLogLevel(WARN);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "pingpong");
+    server.setThreadNum(ioThreads);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+
+    std::vector<std::vector<int64_t>> latencies(sessions);
+    std::thread clients([&]() {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < sessions; ++i)
+        {
+            threads.emplace_back(runSession, msgSize, seconds, &latencies[i]);
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        loop.quit();
+    });
+    loop.loop();
+    clients.join();
+
+    std::vector<int64_t> all;
+    for (const std::vector<int64_t> &l : latencies)
+    {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    if (all.empty())
+    {
+        printf("no round trips\n");
+        return 1;
+    }
+    std::sort(all.begin(), all.end());
+    const char *uring = ::getenv("MUDUO_USE_IOURING");
+    const char *backend = (uring && std::string(uring) != "0") ? "io_uring" : "epoll";
+    double rate = all.size() / seconds;
+    printf("backend=%s sessions=%d msg=%zu io_threads=%d\n", backend, sessions, msgSize, ioThreads);
+    printf("%.0f round trips/s  %.1f MiB/s\n", rate, rate * msgSize * 2 / (1024 * 1024));
+    printf("latency us: p50=%ld p99=%ld p999=%ld max=%ld\n",
+           all[all.size() / 2], all[all.size() * 99 / 100], all[all.size() * 999 / 1000], all.back());
+    return 0;
+}
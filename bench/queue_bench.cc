@@ -0,0 +1,96 @@
+// queueInLoop 多线程投递性能测试: 吞吐 / 投递到执行的延迟 / loop被唤醒的轮数
+// 用法: ./queue_bench [每个生产者投递的任务数 默认200000] [最大生产者数 默认32]
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Timestamp.h"
+
+// 只在loop线程里访问
+static std::vector<int64_t> g_latencies;
+static int64_t g_done = 0;
+
+static void runOnce(EventLoop *loop, int producers, int tasksPerProducer)
+{
+    const int64_t total = static_cast<int64_t>(producers) * tasksPerProducer;
+    int64_t startIteration = 0;
+    loop->runInLoop([&]() {
+        g_latencies.clear();
+        g_latencies.reserve(total);
+        g_done = 0;
+        startIteration = loop->iteration();
+    });
+
+    std::atomic<int64_t> finished(0);
+    std::atomic_bool go(false);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&]() {
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < tasksPerProducer; ++i)
+            {
+                MonotonicTime enqueued(MonotonicTime::now());
+                loop->queueInLoop([enqueued, total, &finished]() {
+                    g_latencies.push_back(timeDifference(MonotonicTime::now(), enqueued) * 1e6);
+                    if (++g_done == total)
+                    {
+                        finished.store(1, std::memory_order_release);
+                    }
+                });
+            }
+        });
+    }
+
+    MonotonicTime start(MonotonicTime::now());
+    go.store(true, std::memory_order_release);
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    while (finished.load(std::memory_order_acquire) == 0)
+    {
+        std::this_thread::yield();
+    }
+    double seconds = timeDifference(MonotonicTime::now(), start);
+
+    int64_t p50 = 0, p99 = 0, iterations = 0;
+    std::atomic_bool collected(false);
+    loop->runInLoop([&]() {
+        std::sort(g_latencies.begin(), g_latencies.end());
+        p50 = g_latencies[g_latencies.size() / 2];
+        p99 = g_latencies[g_latencies.size() * 99 / 100];
+        iterations = loop->iteration() - startIteration;
+        collected.store(true, std::memory_order_release);
+    });
+    while (!collected.load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+
+    printf("%3d producers %10ld tasks %12.0f tasks/s  p50 %6ld us  p99 %7ld us  loop iterations %8ld (%.1f tasks/iter)\n",
+           producers, total, total / seconds, p50, p99, iterations,
+           iterations > 0 ? static_cast<double>(total) / iterations : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    int tasksPerProducer = argc > 1 ? atoi(argv[1]) : 200000;
+    int maxProducers = argc > 2 ? atoi(argv[2]) : 32;
+
+    EventLoopThread thread;
+    EventLoop *loop = thread.startLoop();
+    for (int producers = 1; producers <= maxProducers; producers *= 2)
+    {
+        runOnce(loop, producers, tasksPerProducer);
+    }
+    return 0;
+}
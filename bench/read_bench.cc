@@ -0,0 +1,103 @@
+// Buffer::readFd 性能测试
+//   小消息请求/响应: 写一个小消息 readFd读出来 retrieveAll 单线程反复做 看每次读的开销
+//   大块流式接收: 另一个线程一直写 readFd一直读 看吞吐和平均每次读到多少
+// 用法: ./read_bench [小消息字节 默认64] [小消息次数 默认1000000] [流式MiB 默认2048]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <string>
+#include <thread>
+
+#include "Buffer.h"
+#include "Timestamp.h"
+
+static void requestResponse(size_t msgSize, int count)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        perror("socketpair");
+        ::exit(1);
+    }
+    std::string msg(msgSize, 'x');
+    Buffer buffer;
+    int savedErrno = 0;
+    MonotonicTime start(MonotonicTime::now());
+    for (int i = 0; i < count; ++i)
+    {
+        if (::write(fds[0], msg.data(), msgSize) != static_cast<ssize_t>(msgSize))
+        {
+            perror("write");
+            ::exit(1);
+        }
+        buffer.readFd(fds[1], &savedErrno);
+        buffer.retrieveAll();
+    }
+    double seconds = timeDifference(MonotonicTime::now(), start);
+    printf("request/response  msg %6zu B  %9d reads  %7.0f ns/round  %10.0f rounds/s\n",
+           msgSize, count, seconds * 1e9 / count, count / seconds);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+static void streaming(size_t total)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        perror("socketpair");
+        ::exit(1);
+    }
+    int sndbuf = 4 * 1024 * 1024;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+    std::thread writer([fd = fds[0], total]() {
+        std::string chunk(1024 * 1024, 'x');
+        size_t left = total;
+        while (left > 0)
+        {
+            ssize_t n = ::write(fd, chunk.data(), std::min(left, chunk.size()));
+            if (n <= 0)
+            {
+                break;
+            }
+            left -= n;
+        }
+        ::close(fd);
+    });
+
+    Buffer buffer;
+    size_t received = 0;
+    int64_t reads = 0;
+    int savedErrno = 0;
+    MonotonicTime start(MonotonicTime::now());
+    for (;;)
+    {
+        ssize_t n = buffer.readFd(fds[1], &savedErrno);
+        if (n <= 0)
+        {
+            break;
+        }
+        ++reads;
+        received += n;
+        buffer.retrieveAll();
+    }
+    double seconds = timeDifference(MonotonicTime::now(), start);
+    writer.join();
+    ::close(fds[1]);
+    printf("streaming  %6zu MiB  %8.1f MiB/s  %8ld reads  %6.1f KiB/read  read hint %zu\n",
+           received / (1024 * 1024), received / seconds / (1024 * 1024), reads,
+           static_cast<double>(received) / reads / 1024, buffer.readHint());
+}
+
+int main(int argc, char *argv[])
+{
+    size_t msgSize = argc > 1 ? atoi(argv[1]) : 64;
+    int count = argc > 2 ? atoi(argv[2]) : 1000000;
+    size_t total = static_cast<size_t>(argc > 3 ? atoi(argv[3]) : 2048) * 1024 * 1024;
+
+    requestResponse(msgSize, count);
+    requestResponse(4096, count / 4);
+    streaming(total);
+    return 0;
+}
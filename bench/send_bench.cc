@@ -0,0 +1,173 @@
+// TcpConnection::send 各个接口的发送吞吐: 在IO线程里发 / 在别的线程里发
+//   copy:   每条消息先拼成string 用const引用发(跨线程要拷贝 没写完的部分也要拷贝进输出缓冲区)
+//   move:   每条消息先拼成string 用右值发(跨线程直接移交 没写完的大块直接接管)
+//   concat: header + body 拼成一个string再右值发
+//   gather: header + body 两段直接send({header, body}) 输出缓冲区为空时一次writev
+// 用法: ./send_bench [消息大小 默认16384] [每种模式发送的MiB 默认512]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19985;
+static const size_t kWindow = 16 * 1024 * 1024; // 发出去还没被客户端读走的最多这么多
+
+static std::atomic<int64_t> g_received(0);
+static std::atomic<bool> g_connected(false);
+static TcpConnectionPtr g_conn;
+
+enum Mode { kCopy, kMove, kConcat, kGather };
+static const char *kModeNames[] = {"copy", "move", "concat", "gather"};
+
+static const size_t kHeaderSize = 32;
+
+// 发一条消息 总长msgSize(含header)
+static void sendOne(const TcpConnectionPtr &conn, Mode mode, const std::string &header, const std::string &body)
+{
+    switch (mode)
+    {
+    case kCopy:
+    {
+        std::string message(header + body);
+        conn->send(message);
+        break;
+    }
+    case kMove:
+    {
+        std::string message(header + body);
+        conn->send(std::move(message));
+        break;
+    }
+    case kConcat:
+    {
+        std::string message;
+        message.reserve(header.size() + body.size());
+        message.append(header);
+        message.append(body);
+        conn->send(std::move(message));
+        break;
+    }
+    case kGather:
+        conn->send({header, body});
+        break;
+    }
+}
+
+static void run(EventLoop *ioLoop, Mode mode, bool inLoop, size_t msgSize, int64_t total)
+{
+    const TcpConnectionPtr conn = g_conn;
+    const std::string header(kHeaderSize, 'h');
+    const std::string body(msgSize - kHeaderSize, 'b');
+    const int64_t base = g_received.load();
+    const int64_t count = total / msgSize;
+    total = count * msgSize;
+
+    MonotonicTime start(MonotonicTime::now());
+    if (inLoop)
+    {
+        // IO线程里定时补发 保持在途数据不超过kWindow
+        int64_t sent = 0;
+        TimerId timer = ioLoop->runEvery(0.0005, [&]() {
+            while (sent < count && (sent * static_cast<int64_t>(msgSize)) - (g_received.load() - base) < static_cast<int64_t>(kWindow))
+            {
+                sendOne(conn, mode, header, body);
+                ++sent;
+            }
+        });
+        while (g_received.load() - base < total)
+        {
+            ::usleep(200);
+        }
+        ioLoop->cancel(timer);
+    }
+    else
+    {
+        for (int64_t sent = 0; sent < count; ++sent)
+        {
+            while ((sent * static_cast<int64_t>(msgSize)) - (g_received.load() - base) >= static_cast<int64_t>(kWindow))
+            {
+                std::this_thread::yield();
+            }
+            sendOne(conn, mode, header, body);
+        }
+        while (g_received.load() - base < total)
+        {
+            std::this_thread::yield();
+        }
+    }
+    double seconds = timeDifference(MonotonicTime::now(), start);
+    printf("%-12s %-6s msg %7zu B  %8.1f MiB/s  %9.0f msgs/s\n", inLoop ? "in-loop" : "cross-thread",
+           kModeNames[mode], msgSize, total / seconds / (1024 * 1024), count / seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t msgSize = argc > 1 ? atoi(argv[1]) : 16384;
+    int64_t total = static_cast<int64_t>(argc > 2 ? atoi(argv[2]) : 512) * 1024 * 1024;
+    if (msgSize <= kHeaderSize)
+    {
+        msgSize = kHeaderSize + 1;
+    }
+
+    Logger::setLogLevel(WARN);
+    EventLoopThread serverThread;
+    EventLoop *ioLoop = serverThread.startLoop();
+    TcpServer *server = nullptr;
+    ioLoop->runInLoop([&]() {
+        server = new TcpServer(ioLoop, InetAddress(kPort), "send");
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                g_conn = conn;
+                g_connected.store(true);
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+        server->start();
+    });
+
+    ::usleep(100 * 1000);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        perror("connect");
+        return 1;
+    }
+    std::thread reader([fd]() {
+        static char buf[256 * 1024];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0)
+        {
+            g_received.fetch_add(n);
+        }
+    });
+    while (!g_connected.load())
+    {
+        std::this_thread::yield();
+    }
+
+    for (int inLoop = 1; inLoop >= 0; --inLoop)
+    {
+        for (int mode = kCopy; mode <= kGather; ++mode)
+        {
+            run(ioLoop, static_cast<Mode>(mode), inLoop, msgSize, total);
+        }
+    }
+
+    ::shutdown(fd, SHUT_WR);
+    g_conn->shutdown();
+    g_conn.reset();
+    reader.join();
+    ::close(fd);
+    ioLoop->runInLoop([&]() { delete server; });
+    return 0;
+}
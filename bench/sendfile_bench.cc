@@ -0,0 +1,212 @@
+// 大文件发给慢读者: 测服务端IO线程的CPU占用 同时校验收到的字节流
+//   file:  每个连接只sendFile整个文件 writeComplete里shutdown
+//   mixed: send(header) + sendFile + send(trailer) 校验三段的顺序 writeComplete只能在trailer发完后来
+// 客户端每次读64 KiB后睡一会 模拟比服务端慢得多的下载方
+// 用法: ./sendfile_bench [连接数 默认8] [文件MiB 默认32] [每次读之后睡的微秒 默认500]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19987;
+static const char kHeader[] = "BEGIN\r\n";
+static const char kTrailer[] = "\r\nEND\r\n";
+
+static int g_fileFd = -1;
+static size_t g_fileSize = 0;
+static bool g_mixed = false;
+static std::atomic<int> g_completes(0);
+
+static char patternAt(size_t i)
+{
+    return static_cast<char>('a' + i % 26);
+}
+
+static double threadCpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// 在IO线程里取它自己的CPU时间
+static double loopCpuSeconds(EventLoop *loop)
+{
+    std::atomic<bool> done(false);
+    double seconds = 0;
+    loop->runInLoop([&]() {
+        seconds = threadCpuSeconds();
+        done.store(true);
+    });
+    while (!done.load())
+    {
+        ::usleep(100);
+    }
+    return seconds;
+}
+
+// 读到EOF 校验内容 返回是否完全正确
+static bool download(int delayUs)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        perror("connect");
+        ::close(fd);
+        return false;
+    }
+    std::string expectHead = g_mixed ? kHeader : "";
+    std::string expectTail = g_mixed ? kTrailer : "";
+    size_t expectTotal = expectHead.size() + g_fileSize + expectTail.size();
+    size_t pos = 0;
+    bool ok = true;
+    static thread_local char buf[64 * 1024];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        for (ssize_t i = 0; i < n && ok; ++i, ++pos)
+        {
+            char expect;
+            if (pos < expectHead.size())
+            {
+                expect = expectHead[pos];
+            }
+            else if (pos < expectHead.size() + g_fileSize)
+            {
+                expect = patternAt(pos - expectHead.size());
+            }
+            else if (pos < expectTotal)
+            {
+                expect = expectTail[pos - expectHead.size() - g_fileSize];
+            }
+            else
+            {
+                ok = false;
+                break;
+            }
+            ok = (buf[i] == expect);
+        }
+        if (!ok)
+        {
+            break;
+        }
+        if (delayUs > 0)
+        {
+            ::usleep(delayUs);
+        }
+    }
+    ::close(fd);
+    return ok && pos == expectTotal;
+}
+
+static void run(EventLoop *loop, int clients, int delayUs)
+{
+    g_completes.store(0);
+    std::atomic<int> good(0);
+    double cpuStart = loopCpuSeconds(loop);
+    MonotonicTime start(MonotonicTime::now());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i)
+    {
+        threads.emplace_back([&]() {
+            if (download(delayUs))
+            {
+                good.fetch_add(1);
+            }
+        });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    double seconds = timeDifference(MonotonicTime::now(), start);
+    double cpu = loopCpuSeconds(loop) - cpuStart;
+    double mib = static_cast<double>(clients) * g_fileSize / (1024 * 1024);
+    printf("%-5s %2d clients  %7.1f MiB/s  wall %6.2f s  io-thread cpu %6.3f s (%5.1f%%)  %5.1f ms cpu/GiB  ok %d/%d  writeComplete %d\n",
+           g_mixed ? "mixed" : "file", clients, mib / seconds, seconds, cpu, cpu / seconds * 100,
+           cpu * 1000 / (mib / 1024), good.load(), clients, g_completes.load());
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 8;
+    g_fileSize = static_cast<size_t>(argc > 2 ? atoi(argv[2]) : 32) * 1024 * 1024;
+    int delayUs = argc > 3 ? atoi(argv[3]) : 500;
+
+    char path[] = "/tmp/sendfile_bench_XXXXXX";
+    g_fileFd = ::mkstemp(path);
+    if (g_fileFd < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    ::unlink(path);
+    {
+        std::string chunk(1024 * 1024, 0);
+        for (size_t off = 0; off < g_fileSize; off += chunk.size())
+        {
+            size_t len = std::min(chunk.size(), g_fileSize - off);
+            for (size_t i = 0; i < len; ++i)
+            {
+                chunk[i] = patternAt(off + i);
+            }
+            if (::pwrite(g_fileFd, chunk.data(), len, off) != static_cast<ssize_t>(len))
+            {
+                perror("pwrite");
+                return 1;
+            }
+        }
+    }
+
+    Logger::setLogLevel(WARN);
+    EventLoopThread serverThread;
+    EventLoop *ioLoop = serverThread.startLoop();
+    TcpServer *server = nullptr;
+    ioLoop->runInLoop([&]() {
+        server = new TcpServer(ioLoop, InetAddress(kPort), "sendfile");
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                if (g_mixed)
+                {
+                    conn->send(kHeader);
+                }
+                conn->sendFile(g_fileFd, 0, g_fileSize);
+                if (g_mixed)
+                {
+                    conn->send(kTrailer);
+                }
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+        server->setWriteCompleteCallback([](const TcpConnectionPtr &conn) {
+            g_completes.fetch_add(1);
+            conn->shutdown();
+        });
+        server->start();
+    });
+    ::usleep(100 * 1000);
+
+    g_mixed = false;
+    run(ioLoop, clients, delayUs);
+    g_mixed = true;
+    run(ioLoop, clients, delayUs);
+
+    ioLoop->runInLoop([&]() { delete server; });
+    ::usleep(100 * 1000);
+    ::close(g_fileFd);
+    return 0;
+}
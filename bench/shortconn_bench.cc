@@ -0,0 +1,212 @@
+// 短连接事务: 客户端 连接 -> 发16字节请求 -> 读16字节响应 -> 读到EOF -> RST关闭 服务端回完响应就shutdown
+// 对比监听socket的三种设置 统计每秒事务数 以及服务端所有loop每个事务的循环次数(epoll返回次数)和CPU
+//   plain:        什么都不开 accept之后交给IO loop 下一轮epoll才读到请求
+//   defer-accept: TCP_DEFER_ACCEPT 请求到了才accept 建立后直接读
+//   fastopen:     再加服务端TFO 客户端TCP_FASTOPEN_CONNECT 请求跟SYN一起发 (要net.ipv4.tcp_fastopen打开0x2位)
+// 用法: ./shortconn_bench [客户端线程数 默认4] [每项秒数 默认2] [IO线程数 默认2]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19994;
+static const size_t kMessageSize = 16;
+
+enum Mode { kPlain, kDeferAccept, kFastOpen };
+static const char *kModeNames[] = {"plain", "defer-accept", "fastopen"};
+
+static std::mutex g_mutex;
+static std::vector<EventLoop *> g_loops;
+
+struct LoopStats
+{
+    double cpuSeconds;
+    int64_t iterations;
+};
+
+static LoopStats loopStats(EventLoop *loop)
+{
+    std::atomic<bool> done(false);
+    LoopStats stats = {0, 0};
+    loop->runInLoop([&]() {
+        struct rusage usage;
+        ::getrusage(RUSAGE_THREAD, &usage);
+        stats.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        stats.iterations = loop->iteration();
+        done.store(true);
+    });
+    while (!done.load())
+    {
+        ::usleep(100);
+    }
+    return stats;
+}
+
+static LoopStats serverStats()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    LoopStats total = {0, 0};
+    for (EventLoop *loop : g_loops)
+    {
+        LoopStats stats = loopStats(loop);
+        total.cpuSeconds += stats.cpuSeconds;
+        total.iterations += stats.iterations;
+    }
+    return total;
+}
+
+static int64_t runClient(Mode mode, double seconds)
+{
+    InetAddress addr(kPort);
+    char request[kMessageSize];
+    char buf[64];
+    ::memset(request, 'q', sizeof request);
+    struct linger lingerOpt = {1, 0};
+    int one = 1;
+    int64_t done = 0;
+    MonotonicTime end(addTime(MonotonicTime::now(), seconds));
+    while (MonotonicTime::now() < end)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (mode == kFastOpen)
+        {
+            // connect立刻返回 第一次write的数据跟SYN一起发(有cookie时)
+            ::setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &one, sizeof one);
+        }
+        if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0 ||
+            ::write(fd, request, sizeof request) != static_cast<ssize_t>(sizeof request))
+        {
+            perror("connect/write");
+            ::close(fd);
+            break;
+        }
+        size_t got = 0;
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0)
+        {
+            got += n;
+        }
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lingerOpt, sizeof lingerOpt);
+        ::close(fd);
+        if (got == kMessageSize)
+        {
+            ++done;
+        }
+    }
+    return done;
+}
+
+static void run(EventLoop *baseLoop, Mode mode, int clients, double seconds, int ioThreads)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_loops.clear();
+        if (ioThreads > 0)
+        {
+            g_loops.push_back(baseLoop); // 只有0个IO线程时threadInitCallback才会拿到baseloop
+        }
+    }
+    TcpServer *server = nullptr;
+    std::promise<void> started;
+    baseLoop->runInLoop([&]() {
+        server = new TcpServer(baseLoop, InetAddress(kPort), "shortconn");
+        server->setThreadNum(ioThreads);
+        if (mode != kPlain)
+        {
+            server->setDeferAccept(5);
+        }
+        if (mode == kFastOpen)
+        {
+            server->setFastOpen(1024);
+        }
+        server->setThreadInitCallback([](EventLoop *loop) {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_loops.push_back(loop);
+        });
+        server->setConnectionCallback([](const TcpConnectionPtr &) {});
+        server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            if (buf->readableBytes() >= kMessageSize)
+            {
+                conn->send(buf->peek(), kMessageSize);
+                buf->retrieveAll();
+                conn->shutdown();
+            }
+        });
+        server->start();
+        started.set_value();
+    });
+    started.get_future().wait();
+    ::usleep(50 * 1000);
+
+    LoopStats before = serverStats();
+    std::atomic<int64_t> total(0);
+    MonotonicTime start(MonotonicTime::now());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i)
+    {
+        threads.emplace_back([&]() { total.fetch_add(runClient(mode, seconds)); });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    double elapsed = timeDifference(MonotonicTime::now(), start);
+    ::usleep(50 * 1000);
+    LoopStats after = serverStats();
+    int64_t n = std::max<int64_t>(total.load(), 1);
+    printf("%-12s %8.0f txn/s  server %5.2f loop iterations/txn  %5.2f us cpu/txn\n", kModeNames[mode],
+           total.load() / elapsed, static_cast<double>(after.iterations - before.iterations) / n,
+           (after.cpuSeconds - before.cpuSeconds) * 1e6 / n);
+
+    std::promise<void> stopped;
+    baseLoop->runInLoop([&]() {
+        delete server;
+        stopped.set_value();
+    });
+    stopped.get_future().wait();
+    ::usleep(50 * 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 4;
+    double seconds = argc > 2 ? atof(argv[2]) : 2;
+    int ioThreads = argc > 3 ? atoi(argv[3]) : 2;
+
+    FILE *fp = ::fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+    int fastOpenSysctl = 0;
+    if (fp != nullptr)
+    {
+        if (::fscanf(fp, "%d", &fastOpenSysctl) != 1)
+        {
+            fastOpenSysctl = 0;
+        }
+        ::fclose(fp);
+    }
+    if ((fastOpenSysctl & 3) != 3)
+    {
+        printf("net.ipv4.tcp_fastopen=%d, fastopen falls back to a normal handshake (needs 3)\n", fastOpenSysctl);
+    }
+
+    Logger::setLogLevel(FATAL); // 客户端用RST关闭 服务端会打ECONNRESET的ERROR
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    for (int mode = kPlain; mode <= kFastOpen; ++mode)
+    {
+        run(baseLoop, static_cast<Mode>(mode), clients, seconds, ioThreads);
+    }
+    return 0;
+}
@@ -0,0 +1,322 @@
+// 连接洪峰下的accept: 客户端一口气建一大批长连接不关
+//   batch N:  每次可读事件accept N个 统计accepts/s和baseloop每个连接花的CPU
+//   maxconn:  setMaxConnections 到上限后暂停accept 看baseloop是否闲下来 服务端关掉一部分后能否继续accept
+//   emfile:   服务端进程fd上限压得很低 看fd用完之后baseloop的CPU和被拒绝的连接数
+//             (客户端放在fork出来的子进程里 不受服务端fd上限影响)
+// 用法: ./storm_bench [客户端线程数 默认4] [每个线程连接数 默认1000]
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19993;
+static const int kEmfileConnections = 600;
+static const int kEmfileSpareFds = 200; // 服务端在现有fd之外还能再开多少个
+
+static std::atomic<int> g_established(0);
+static std::atomic<int> g_destroyed(0);
+static std::mutex g_mutex;
+static std::vector<TcpConnectionPtr> g_conns;
+
+static double loopCpuSeconds(EventLoop *loop)
+{
+    std::atomic<bool> done(false);
+    double seconds = 0;
+    loop->runInLoop([&]() {
+        struct rusage usage;
+        ::getrusage(RUSAGE_THREAD, &usage);
+        seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        done.store(true);
+    });
+    while (!done.load())
+    {
+        ::usleep(100);
+    }
+    return seconds;
+}
+
+static int connectOne()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    InetAddress addr(kPort);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void closeAll(std::vector<int> *fds)
+{
+    struct linger lingerOpt = {1, 0};
+    for (int fd : *fds)
+    {
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lingerOpt, sizeof lingerOpt);
+        ::close(fd);
+    }
+    fds->clear();
+}
+
+static void waitFor(const std::atomic<int> &counter, int target, double seconds)
+{
+    MonotonicTime end(addTime(MonotonicTime::now(), seconds));
+    while (counter.load() < target && MonotonicTime::now() < end)
+    {
+        ::usleep(1000);
+    }
+}
+
+static TcpServer *startServer(EventLoop *baseLoop, int batch, int maxConnections)
+{
+    g_established.store(0);
+    g_destroyed.store(0);
+    TcpServer *server = nullptr;
+    std::promise<void> started;
+    baseLoop->runInLoop([&]() {
+        server = new TcpServer(baseLoop, InetAddress(kPort), "storm");
+        server->setThreadNum(2);
+        server->setAcceptBatch(batch);
+        server->setMaxConnections(maxConnections);
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                g_established.fetch_add(1);
+                std::lock_guard<std::mutex> lock(g_mutex);
+                g_conns.push_back(conn);
+            }
+            else
+            {
+                g_destroyed.fetch_add(1);
+            }
+        });
+        server->start();
+        started.set_value();
+    });
+    started.get_future().wait();
+    return server;
+}
+
+static void stopServer(EventLoop *baseLoop, TcpServer *server)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_conns.clear();
+    }
+    std::promise<void> stopped;
+    baseLoop->runInLoop([&]() {
+        delete server;
+        stopped.set_value();
+    });
+    stopped.get_future().wait();
+    ::usleep(50 * 1000);
+}
+
+static void runStorm(EventLoop *baseLoop, int batch, int clients, int perClient)
+{
+    TcpServer *server = startServer(baseLoop, batch, 0);
+    int total = clients * perClient;
+    std::vector<std::vector<int>> fds(clients);
+    double cpuStart = loopCpuSeconds(baseLoop);
+    MonotonicTime start(MonotonicTime::now());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i)
+    {
+        threads.emplace_back([&fds, i, perClient]() {
+            for (int k = 0; k < perClient; ++k)
+            {
+                int fd = connectOne();
+                if (fd >= 0)
+                {
+                    fds[i].push_back(fd);
+                }
+            }
+        });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    waitFor(g_established, total, 10);
+    double elapsed = timeDifference(MonotonicTime::now(), start);
+    double cpu = loopCpuSeconds(baseLoop) - cpuStart;
+    int established = g_established.load();
+    printf("batch %-3d  %5d conns  %8.0f accepts/s  baseloop cpu %5.2f us/conn\n", batch, established,
+           established / elapsed, cpu * 1e6 / std::max(established, 1));
+
+    for (std::vector<int> &v : fds)
+    {
+        closeAll(&v);
+    }
+    waitFor(g_destroyed, established, 10);
+    stopServer(baseLoop, server);
+}
+
+static void runMaxConnections(EventLoop *baseLoop, int maxConnections, int attempts)
+{
+    TcpServer *server = startServer(baseLoop, Acceptor::kDefaultAcceptBatch, maxConnections);
+    std::vector<int> fds;
+    for (int i = 0; i < attempts; ++i)
+    {
+        int fd = connectOne();
+        if (fd >= 0)
+        {
+            fds.push_back(fd);
+        }
+    }
+    waitFor(g_established, attempts, 0.5);
+    int atLimit = g_established.load();
+
+    double cpuStart = loopCpuSeconds(baseLoop);
+    ::usleep(1000 * 1000);
+    double idleCpu = loopCpuSeconds(baseLoop) - cpuStart;
+
+    // 服务端关掉100个 应该再accept 100个
+    int closed = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (size_t i = 0; i < g_conns.size() && closed < 100; ++i, ++closed)
+        {
+            g_conns[i]->forceClose();
+        }
+    }
+    waitFor(g_established, atLimit + closed, 2);
+    printf("maxconn %d  %d connects  established %d at limit  baseloop cpu %5.1f%% while paused  "
+           "server closed %d -> established %d\n",
+           maxConnections, static_cast<int>(fds.size()), atLimit, idleCpu * 100, closed, g_established.load());
+
+    closeAll(&fds);
+    waitFor(g_destroyed, g_established.load(), 10);
+    stopServer(baseLoop, server);
+}
+
+// 子进程: 收到'c'建连接 回'd' 收到'q'数一下有几个被服务端关掉了 回这个数 然后退出
+static void emfileClient(int commandFd, int replyFd)
+{
+    char command;
+    std::vector<int> fds;
+    while (::read(commandFd, &command, 1) == 1)
+    {
+        if (command == 'c')
+        {
+            for (int i = 0; i < kEmfileConnections; ++i)
+            {
+                int fd = connectOne();
+                if (fd >= 0)
+                {
+                    fds.push_back(fd);
+                }
+            }
+            ::write(replyFd, "d", 1);
+        }
+        else if (command == 'q')
+        {
+            int shed = 0;
+            char buf[16];
+            for (int fd : fds)
+            {
+                ssize_t n = ::recv(fd, buf, sizeof buf, MSG_DONTWAIT);
+                if (n == 0 || (n < 0 && errno != EAGAIN))
+                {
+                    ++shed;
+                }
+            }
+            int reply[2] = {static_cast<int>(fds.size()), shed};
+            ::write(replyFd, reply, sizeof reply);
+            closeAll(&fds);
+            return;
+        }
+    }
+}
+
+static void runEmfile(EventLoop *baseLoop, int commandFd, int replyFd)
+{
+    TcpServer *server = startServer(baseLoop, Acceptor::kDefaultAcceptBatch, 0);
+
+    // 压低服务端进程的fd上限: 现有的fd之外只能再开kEmfileSpareFds个
+    int maxFd = 0;
+    for (int fd = 0; fd < 65536; ++fd)
+    {
+        if (::fcntl(fd, F_GETFD) != -1)
+        {
+            maxFd = fd;
+        }
+    }
+    struct rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    struct rlimit lowered = {static_cast<rlim_t>(maxFd + 1 + kEmfileSpareFds), limit.rlim_max};
+    ::setrlimit(RLIMIT_NOFILE, &lowered);
+
+    char reply;
+    ::write(commandFd, "c", 1);
+    ::read(replyFd, &reply, 1);
+    ::usleep(100 * 1000);
+    double cpuStart = loopCpuSeconds(baseLoop);
+    ::usleep(1000 * 1000);
+    double cpu = loopCpuSeconds(baseLoop) - cpuStart;
+
+    int counts[2] = {0, 0};
+    ::write(commandFd, "q", 1);
+    ::read(replyFd, counts, sizeof counts);
+    printf("emfile     %d connects  established %d  shed %d  baseloop cpu %5.1f%% after fds ran out\n",
+           counts[0], g_established.load(), counts[1], cpu * 100);
+
+    waitFor(g_destroyed, g_established.load(), 5);
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    stopServer(baseLoop, server);
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 4;
+    int perClient = argc > 2 ? atoi(argv[2]) : 1000;
+
+    // 子进程在起任何线程之前fork出来
+    int commandPipe[2];
+    int replyPipe[2];
+    ::pipe(commandPipe);
+    ::pipe(replyPipe);
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        ::close(commandPipe[1]);
+        ::close(replyPipe[0]);
+        emfileClient(commandPipe[0], replyPipe[1]);
+        _exit(0);
+    }
+    ::close(commandPipe[0]);
+    ::close(replyPipe[1]);
+
+    Logger::setLogLevel(FATAL); // RST关闭和EMFILE每个连接都会打ERROR
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+
+    for (int batch : {1, 16, 64})
+    {
+        runStorm(baseLoop, batch, clients, perClient);
+    }
+    runMaxConnections(baseLoop, 500, 1000);
+    runEmfile(baseLoop, commandPipe[1], replyPipe[0]);
+
+    ::waitpid(child, nullptr, 0);
+    return 0;
+}
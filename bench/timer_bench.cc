@@ -0,0 +1,63 @@
+// TimerQueue 性能测试: 插入 / 取消 / 到期触发 的吞吐
+// 用法: ./timer_bench [定时器个数 默认100000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "EventLoop.h"
+#include "Timestamp.h"
+
+static double elapsedSeconds(MonotonicTime start)
+{
+    return timeDifference(MonotonicTime::now(), start);
+}
+
+static void report(const char *what, int n, double seconds)
+{
+    printf("%-8s %8d timers %10.3f ms %12.0f ops/s\n", what, n, seconds * 1000, n / seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    EventLoop loop;
+    std::vector<TimerId> ids;
+    ids.reserve(n);
+    int fired = 0;
+    MonotonicTime fireStart;
+
+    loop.runAfter(0, [&]() {
+        // 插入: 到期时间分散在未来1小时内 模拟大量挂起的超时
+        MonotonicTime start(MonotonicTime::now());
+        for (int i = 0; i < n; ++i)
+        {
+            ids.push_back(loop.runAfter(3600.0 + i * 0.001, []() {}));
+        }
+        report("insert", n, elapsedSeconds(start));
+
+        // 取消
+        start = MonotonicTime::now();
+        for (const TimerId &id : ids)
+        {
+            loop.cancel(id);
+        }
+        report("cancel", n, elapsedSeconds(start));
+
+        // 触发: n个定时器在同一时刻到期 统计从到期到全部执行完的时间
+        Timestamp when(addTime(Timestamp::now(), 0.05));
+        fireStart = addTime(MonotonicTime::now(), 0.05);
+        for (int i = 0; i < n; ++i)
+        {
+            loop.runAt(when, [&]() {
+                if (++fired == n)
+                {
+                    report("fire", n, elapsedSeconds(fireStart));
+                    loop.quit();
+                }
+            });
+        }
+    });
+
+    loop.loop();
+    return 0;
+}
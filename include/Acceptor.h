@@ -5,6 +5,7 @@
 #include "noncopyable.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "TimerId.h"
 
 class EventLoop;
 class InetAddress;
@@ -14,6 +15,10 @@ class Acceptor : noncopyable
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress &)>;
 
+    static const int kDefaultAcceptBatch = 16;
+    // fd用完又腾不出预留fd来拒绝连接时 停多久再accept
+    static constexpr double kBackOffSeconds = 0.1;
+
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
     ~Acceptor();
     //设置新连接的回调函数
@@ -22,13 +27,30 @@ public:
     bool listenning() const { return listenning_; }
     // 监听本地端口
     void listen();
+    Socket *socket() { return &acceptSocket_; }
+
+    // 一次可读事件最多accept多少个连接 监听socket是水平触发的 没accept完下一轮还会来
+    void setAcceptBatch(int batch) { acceptBatch_ = batch > 0 ? batch : 1; }
+    // 暂停/恢复accept(从poller上摘掉/加回EPOLLIN) 新连接留在内核的全连接队列里 只能在loop线程里调用
+    void pause();
+    void resume();
+    bool paused() const { return paused_; }
 
 private:
     void handleRead();//处理新用户的连接事件
+    // EMFILE时用预留fd接下一个连接马上关掉 没有预留fd时返回false
+    bool shedOne(bool *queueEmpty);
+    // 暂时从poller上摘掉 kBackOffSeconds后再加回来 和pause互不影响
+    void backOff();
 
     EventLoop *loop_; // Acceptor用的就是用户定义的那个baseLoop 也称作mainLoop
     Socket acceptSocket_;//专门用于接收新连接的socket
     Channel acceptChannel_;//专门用于监听新连接的channel
     NewConnectionCallback NewConnectionCallback_;//新连接的回调函数
     bool listenning_;//是否在监听
+    bool paused_;
+    bool backingOff_;
+    TimerId backOffTimer_;
+    int acceptBatch_;
+    int idleFd_; // 预留的空闲fd 进程fd用完(EMFILE)时先关掉它腾出一个 accept后马上关掉 把连接体面地拒绝掉 没打开时为-1
 };
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+// 定长的日志块 前端往里攒日志 写满一整块才交给后台线程
+class LogBuffer : noncopyable
+{
+public:
+    static const size_t kSize = 4 * 1024 * 1024;
+
+    LogBuffer()
+        : data_(new char[kSize])
+        , cur_(data_.get())
+    {
+    }
+
+    // 放不下的部分截掉 不会写出块外
+    void append(const char *buf, size_t len)
+    {
+        if (len > avail())
+        {
+            len = avail();
+        }
+        ::memcpy(cur_, buf, len);
+        cur_ += len;
+    }
+
+    const char *data() const { return data_.get(); }
+    size_t length() const { return static_cast<size_t>(cur_ - data_.get()); }
+    size_t avail() const { return kSize - length(); }
+    void reset() { cur_ = data_.get(); }
+
+private:
+    std::unique_ptr<char[]> data_;
+    char *cur_;
+};
+
+/**
+ * 异步日志 双缓冲:
+ * 前端(IO线程)只把格式化好的一行memcpy进currentBuffer_, 写满后和空闲块交换, 临界区很短
+ * 后台线程每flushInterval秒或有块写满时被唤醒, 把所有满块一次性换出来再写文件, 写文件时不持锁
+ * 待写的块超过maxPendingBuffers时直接丢弃新日志并计数, 内存有上界
+ *
+ * 用法:
+ *   AsyncLogging log("server", 500 * 1024 * 1024);
+ *   log.start();
+ *   Logger::instance().setOutput(...); // 在输出函数里调用log.append
+ **/
+class AsyncLogging : noncopyable
+{
+public:
+    AsyncLogging(const std::string &basename,
+                 off_t rollSize,
+                 int flushInterval = 3,
+                 size_t maxPendingBuffers = 16);
+    ~AsyncLogging();
+
+    // 线程安全 超过LogBuffer::kSize的一行截断成kSize(末尾补换行)
+    void append(const char *logline, size_t len);
+
+    void start();
+    // 写完所有已提交的日志后退出后台线程 没start过或者重复调用时什么也不做
+    void stop();
+
+    // 因为积压超过上限被丢掉的行数
+    size_t droppedLines() const { return droppedLines_; }
+
+private:
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    void threadFunc();
+
+    const int flushInterval_;
+    const std::string basename_;
+    const off_t rollSize_;
+    const size_t maxPendingBuffers_;
+
+    std::atomic_bool running_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    BufferPtr currentBuffer_; // 前端正在写的块
+    BufferPtr nextBuffer_;    // 预备块 currentBuffer_写满时直接换上 不用分配
+    BufferVector buffers_;    // 写满待落盘的块
+    std::atomic<size_t> droppedLines_;
+};
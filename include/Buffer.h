@@ -1,25 +1,56 @@
 #pragma once
 
-#include <vector>
 #include <string>
 #include <algorithm>
 #include <stddef.h>
+#include <sys/types.h>
 
+class BufferPool;
+
+/**
+ * | kCheapPrepend | 已读 | reader(可读) | writer(可写) |
+ * 存储用到时才分配(空连接不占内存) 挂了BufferPool就从池子里借 读空了就还回去
+ * 容量超过kShrinkThreshold而数据不到1/4时换一块小的 一次大消息不会让连接一直占着大块内存
+ **/
 class Buffer
 {
     public:
         static const size_t kCheapPrepend = 8;
         static const size_t kinitalSize = 1024;
+        static const size_t kShrinkThreshold = 64 * 1024;
+        static const size_t kMaxReadHint = 256 * 1024;
 
         explicit Buffer(size_t initalSize = kinitalSize)
-            : buffer_(kCheapPrepend + initalSize)
+            : Buffer(nullptr, initalSize)
+            {}
+
+        explicit Buffer(BufferPool *pool, size_t initalSize = kinitalSize)
+            : buffer_(emptyStorage())
+            , capacity_(kCheapPrepend)
             , readerIndex_(kCheapPrepend)
             , writerIndex_(kCheapPrepend)
+            , initalSize_(initalSize)
+            , readHint_(initalSize)
+            , smallReads_(0)
+            , pool_(pool)
             {}
 
+        ~Buffer() { release(); }
+
+        Buffer(Buffer &&other) noexcept;
+        Buffer &operator=(Buffer &&other) noexcept;
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+
+        void swap(Buffer &rhs) noexcept;
+
         size_t readableBytes() const { return writerIndex_ - readerIndex_; }
-        size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+        size_t writableBytes() const { return capacity_ - writerIndex_; }
         size_t prependableBytes() const { return readerIndex_; }
+        // readFd下一次预留的空间 按最近几次读到的大小调整
+        size_t readHint() const { return readHint_; }
+        // 当前占用的存储大小 没分配时为0
+        size_t capacity() const { return hasStorage() ? capacity_ : 0; }
 
         // 返回buffer中可读数据的起始地址
         const char* peek() const { return begin() + readerIndex_; } 
@@ -28,6 +59,9 @@ class Buffer
         void retrieve(size_t len) {
             if (len < readableBytes()) {
                 readerIndex_ += len;
+                if (capacity_ > shrinkThreshold() && readableBytes() < capacity_ / 4) {
+                    shrink();
+                }
             } else {
                 retrieveAll();
             }
@@ -36,6 +70,10 @@ class Buffer
         void retrieveAll() {
             readerIndex_ = kCheapPrepend;
             writerIndex_ = kCheapPrepend;
+            // 挂了池子的读空就还回去 单独用的只在块太大时才释放
+            if (pool_ || capacity_ > shrinkThreshold()) {
+                release();
+            }
         }
 
         // 把onMessage函数上报的Buffer数据 转成string类型的数据返回
@@ -47,7 +85,7 @@ class Buffer
             return result;
         }
 
-        // buffer_.size - writerIndex_  当打算写入的时候先检查是否有足够的空间可以写
+        // capacity_ - writerIndex_  当打算写入的时候先检查是否有足够的空间可以写
         void ensureWritableBytes(size_t len) {
             if (len > writableBytes()) {
                 makeSpace(len); //扩容
@@ -61,32 +99,35 @@ class Buffer
             writerIndex_ += len;
         }
 
-        char* benginWrite() { return begin() + writerIndex_; }
+        char* beginWrite() { return begin() + writerIndex_; }
         const char* beginWrite() const { return begin() + writerIndex_; }
 
         ssize_t readFd(int fd, int *saveErrno);
         ssize_t writeFd(int fd, int *saveErrno);
     
     private:
-        char* begin() {return buffer_.data() ; }    
-        const char* begin() const { return buffer_.data(); }   
-
-        void makeSpace(size_t len) {
-            /**
-             * | kCheapPrepend |xxx| reader | writer |                     // xxx标示reader中已读的部分
-             * | kCheapPrepend | reader ｜          len          |
-             **/
-            if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
-                buffer_.resize(writerIndex_ + len);
-            } else {   //把reader搬到从xxx开始，让xxxwriter连续
-                size_t readable = readableBytes();
-                std::copy(begin() + readerIndex_, begin() + writerIndex_, begin() + kCheapPrepend);
-                readerIndex_ = kCheapPrepend;
-                writerIndex_ = readerIndex_ + readable;
-            }
-        }
+        char* begin() {return buffer_; }    
+        const char* begin() const { return buffer_; }   
+
+        // 没有分配存储时buffer_指向一个共享的kCheapPrepend字节的空块 这样各种下标计算不用特判
+        static char *emptyStorage();
+        bool hasStorage() const { return buffer_ != emptyStorage(); }
+
+        void makeSpace(size_t len);
+        // 把可读数据搬到一块能放下readable + len的新存储里
+        void reallocate(size_t len);
+        void shrink() { reallocate(0); }
+        // 正在大量读的连接马上还要这么大的空间 不收缩
+        size_t shrinkThreshold() const { return std::max(kShrinkThreshold, readHint_ * 2); }
+        void release();
+        void adjustReadHint(size_t n);
 
-        std::vector<char> buffer_;
+        char *buffer_;
+        size_t capacity_;
         size_t readerIndex_;
         size_t writerIndex_;
-};
\ No newline at end of file
+        size_t initalSize_;
+        size_t readHint_;   // 读满了翻倍 连续两次不到一半减半 在[initalSize_, kMaxReadHint]之间
+        int smallReads_;
+        BufferPool *pool_;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "noncopyable.h"
+
+class EventLoop;
+
+/**
+ * 每个EventLoop一个的缓冲区内存池 Buffer/ChainBuffer的存储从这里拿
+ * 按2的幂分档(1KB ~ 1MB) 每档一个空闲链表 只在loop线程里用 不加锁
+ * 超过1MB的直接malloc/free; 每档缓存的空闲块有上限 超过的直接还给系统 突发流量过后不会一直占着
+ * 别的线程来借/还(用户在其他线程往Buffer里写 或者最后一个TcpConnectionPtr在别处析构)时直接malloc/free 不碰空闲链表
+ * 但大小同样向上取整到档位 所以这种块之后在loop线程里还回来也能按capacity正确归档
+ **/
+class BufferPool : noncopyable
+{
+public:
+    static const size_t kMinBlockSize = 1024;
+    static const size_t kMaxBlockSize = 1024 * 1024;
+    static const int kNumClasses = 11; // 1KB 2KB ... 1MB
+
+    // 池子占用情况 只能在loop线程里取
+    struct Stats
+    {
+        int64_t blocksInUse;   // 借出去还没还的块
+        int64_t bytesInUse;
+        int64_t cachedBlocks;  // 空闲链表里的块
+        int64_t cachedBytes;
+        int64_t allocations;   // 累计在loop线程里借出的次数
+        int64_t hits;          // 其中直接从空闲链表拿到的
+        int64_t oversized;     // 超过kMaxBlockSize直接malloc的次数
+        int64_t classInUse[kNumClasses];
+        int64_t classCached[kNumClasses];
+    };
+
+    explicit BufferPool(EventLoop *loop, size_t maxCachedBytesPerClass = 4 * 1024 * 1024);
+    ~BufferPool();
+
+    // 返回至少size字节的块 实际可用大小写到*capacity
+    char *allocate(size_t size, size_t *capacity);
+    // capacity必须是allocate返回的大小
+    void deallocate(char *block, size_t capacity);
+
+    // 把空闲链表里缓存的块全部还给系统
+    void trim();
+
+    Stats stats() const;
+
+    // pool为空时退回malloc/free 方便Buffer不挂池子单独用
+    static char *allocate(BufferPool *pool, size_t size, size_t *capacity);
+    static void deallocate(BufferPool *pool, char *block, size_t capacity);
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    static int classIndex(size_t size);
+    static size_t classSize(int index) { return kMinBlockSize << index; }
+
+    EventLoop *loop_;
+    const size_t maxCachedBytesPerClass_;
+
+    FreeBlock *freeLists_[kNumClasses];
+    int64_t cached_[kNumClasses];
+    int64_t inUse_[kNumClasses];
+    int64_t oversizedInUse_;
+    int64_t oversizedBytesInUse_;
+    int64_t allocations_;
+    int64_t hits_;
+    int64_t oversized_;
+
+    // 在别的线程借出/还回的块 只能原子地记增减 取stats时再加上
+    // 单看某一边可能是负数(别的线程借 loop线程还) 两边加起来才是真实占用
+    std::atomic<int64_t> foreignInUse_[kNumClasses];
+    std::atomic<int64_t> foreignOversizedInUse_;
+    std::atomic<int64_t> foreignOversizedBytesInUse_;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+#include "Task.h"
+
+class Buffer;
+class BufferPool;
+
+/**
+ * 由固定大小的slab串起来的缓冲区 接口和Buffer的peek/retrieve/append一致 用作发送缓冲区
+ * Buffer是一整块vector 空间不够时要么把可读数据挪到前面 要么resize(清零再整体拷贝),
+ * 大响应往outputBuffer_里追加时会反复扩容拷贝 ChainBuffer追加只会在尾部挂新的slab 已有数据不会移动
+ *
+ *   | slab0: 已发送 | 可读 |  ->  | slab1: 可读 |  ->  | slab2: 可读 | 可写 |
+ *
+ * writeFd一次writev最多带IOV_MAX个slab
+ * 挂了BufferPool时slab从池子借 发完就还; 没挂池子时留一个spare slab复用
+ * 大块的std::string/Buffer可以整个接管过来当一个slab 不拷贝数据 发完再析构
+ * 零拷贝slab: 数据归调用方 用MSG_ZEROCOPY发送 内核从错误队列通知用完之后才调用release
+ **/
+class ChainBuffer : noncopyable
+{
+public:
+    static const size_t kSlabSize = 16 * 1024;
+    // 比这个小的string/Buffer直接拷贝 比单独new一个对象接管划算
+    static const size_t kAdoptThreshold = 4 * 1024;
+
+    explicit ChainBuffer(BufferPool *pool = nullptr);
+    ~ChainBuffer();
+
+    size_t readableBytes() const { return readable_; }
+    // 链上挂了几个slab 统计用
+    size_t slabCount() const { return slabs_.size(); }
+
+    // 返回可读数据的起始地址 数据跨了多个slab或者在文件里时先读出来合并成一块(慢路径 发送路径用不到)
+    // 文件读不出来(被截断时是EIO)返回nullptr 错误码写到*saveErrno 缓冲区不变
+    const char *peek(int *saveErrno = nullptr);
+
+    void retrieve(size_t len);
+    void retrieveAll();
+
+    std::string retrieveAllAsString() { return retrieveAsString(readableBytes()); }
+    // 文件读不出来时只返回出错的文件段之前的数据 len字节照样全部去掉
+    std::string retrieveAsString(size_t len);
+
+    // 追加到最后一个slab的空闲空间 不够就挂新的slab
+    void append(const char *data, size_t len);
+    // 接管str中从offset开始的数据 足够大时不拷贝
+    void append(std::string &&str, size_t offset = 0);
+    // 接管buf中的可读数据 足够大时不拷贝
+    void append(Buffer &&buf);
+
+    // 零拷贝追加 [data, data+len)在release被调用之前必须一直有效
+    // 只有fd设置了SO_ZEROCOPY才能用 否则内核不会发完成通知 release要等到析构才调用
+    void appendZeroCopy(const char *data, size_t len, Task<void()> release);
+    // 追加文件fd的[offset, offset+count) fd由调用方保证在发完之前一直打开
+    void appendFile(int fd, off_t offset, size_t count);
+
+    // 错误队列里读到的完成通知 [lo, hi]这些次零拷贝发送内核已经用完了
+    void zeroCopyCompleted(uint32_t lo, uint32_t hi);
+    // 已经发出去但内核还没通知完成的零拷贝发送次数
+    size_t zeroCopyInflight() const { return inflight_.size(); }
+    int64_t zeroCopySends() const { return zeroCopySends_; }
+
+    // 把可读数据用一次writev写到fd 队头是零拷贝slab时用一次MSG_ZEROCOPY的send 是文件时用一次sendfile
+    // 文件比登记的长度短(被截断)时返回-1 *saveErrno为EIO
+    ssize_t writeFd(int fd, int *saveErrno);
+
+private:
+    struct ZeroCopyOwner
+    {
+        Task<void()> release;
+        int pendingSends; // 还没收到完成通知的发送次数
+        bool consumed;    // 数据已经全部发出去 slab已经从链上摘掉
+    };
+
+    struct InflightSend
+    {
+        uint32_t id;      // 内核给每次成功的MSG_ZEROCOPY发送按顺序编号
+        ZeroCopyOwner *owner;
+    };
+
+    struct Slab
+    {
+        Slab() = default;
+        // [readerIndex, writerIndex)是可读数据 其余字段按需要单独设置
+        Slab(char *d, size_t sz, size_t reader, size_t writer)
+            : data(d), size(sz), readerIndex(reader), writerIndex(writer) {}
+
+        char *data = nullptr;
+        size_t size = 0;
+        size_t readerIndex = 0;
+        size_t writerIndex = 0;
+        std::string *ownedString = nullptr; // 接管过来的数据 不为空时data指向它们内部 释放时delete
+        Buffer *ownedBuffer = nullptr;
+        ZeroCopyOwner *zeroCopy = nullptr;
+        bool file = false;   // 文件slab data为空 数据在fileFd的fileOffset + readerIndex处
+        int fileFd = -1;
+        off_t fileOffset = 0;
+
+        size_t readableBytes() const { return writerIndex - readerIndex; }
+        size_t writableBytes() const { return size - writerIndex; }
+    };
+
+    Slab newSlab(size_t size);
+    void popFront();
+
+    void freeSlab(Slab &slab);
+    ssize_t sendZeroCopy(int fd, int *saveErrno);
+    ssize_t sendFileSlab(int fd, int *saveErrno);
+    // 拷贝slab开头n字节可读数据到dst 文件slab用pread 读不全返回false 错误码写到*saveErrno
+    static bool copyOut(const Slab &slab, char *dst, size_t n, int *saveErrno);
+    static void releaseOwner(ZeroCopyOwner *owner);
+
+    BufferPool *pool_;
+    std::deque<Slab> slabs_;
+    Slab spare_;       // 没有池子时留一个发送完的slab下次直接用 避免稳定收发时反复new/delete
+    size_t readable_;
+
+    std::deque<InflightSend> inflight_;
+    uint32_t nextZeroCopyId_;
+    int64_t zeroCopySends_;
+};
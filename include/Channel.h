@@ -4,15 +4,16 @@
 #include <memory>
 
 #include "noncopyable.h"
+#include "Timestamp.h"
+#include "Task.h"
 
 // 前向声明EventLoop类, 如果没有创建对象，访问成员， 就不需要完整定义，只需声明告诉编译器这个类存在。
 class EventLoop;  
-class Timestamp;
 
 class Channel : noncopyable{
     public:
-        using EventCallback = std::function<void()>; 
-        using ReadEventCallback = std::function<void(Timestamp)>;
+        using EventCallback = Task<void()>;
+        using ReadEventCallback = Task<void(Timestamp)>;
 
         Channel(EventLoop *loop, int fd);
         ~Channel();
@@ -33,6 +34,13 @@ class Channel : noncopyable{
         void enableWriting() { events_ |= kWriteEvent; update(); }
         void disableWriting() { events_ &= ~kWriteEvent; update(); }
         void disableAll() { events_ = kNoneEvent; update(); }
+        // epoll总会报EPOLLERR 这里只是让events_不为空 读写都关掉时fd也留在poller里
+        void enableErrorEvents() { events_ |= kErrorEvent; update(); }
+
+        // 边沿触发: 回调保证每次都把fd读/写到EAGAIN(或者像eventfd/timerfd一样读一次就清空)
+        // epoll注册时带上EPOLLET, io_uring用multishot poll 不用每次重新挂
+        void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+        bool isEdgeTriggered() const { return edgeTriggered_; }
 
         // 返回fd当前的事件状态
         bool isNoneEvent() const { return events_ == kNoneEvent; }
@@ -44,11 +52,12 @@ class Channel : noncopyable{
 
         int fd() const { return fd_; }
         int events() const { return events_; }
+        int revents() const { return revents_; }
 
         // 外部将实际发生的时间封装进channel里
-        int set_revents(int revt) {revents_ = revt; }
+        void set_revents(int revt) { revents_ = revt; }
 
-        int index() { return index_; }
+        int index() const { return index_; }
         void set_index(int idx) { index_ = idx; }
 
         // one loop per thread
@@ -63,16 +72,18 @@ class Channel : noncopyable{
         static const int kNoneEvent;
         static const int kReadEvent;
         static const int kWriteEvent;
+        static const int kErrorEvent;
 
+        // 每次poll/update都要碰的字段放在最前面 挤在同一条cache line里(前32字节)
         const int fd_;      // fd，Poller监听的对象
         int events_;        // 注册fd感兴趣的事件
         int revents_;       // Poller返回的具体发生的事件
-        EventLoop* loop_;    // 事件循环
-
         int index_; //记录在poller的状态，epoll_ctl只能加一次，之后只能改变
+        bool tied_;     // 有tie_, 就说明还连接着。
+        bool edgeTriggered_;
+        EventLoop* loop_;    // 事件循环
 
         std::weak_ptr<void> tie_;  // TcpConnection 的指针，检查这个channel是否还活着（连接关闭没有）
-        bool tied_;     // 有tie_, 就说明还连接着。
 
 
         ReadEventCallback readCallback_;
@@ -4,18 +4,33 @@
 #include <vector>
 #include <atomic>
 #include <memory>
-#include <mutex>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "MpscQueue.h"
+#include "Task.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
+class BufferPool;
 
 class EventLoop : noncopyable {
     public:
-        using Functor = std::function<void()>;
+        using Functor = Task<void()>; // 只能移动 小对象不分配内存
+
+        // busy-poll统计 都是累计值 任何线程都可以读
+        struct BusyPollStats
+        {
+            int64_t spinMicroSeconds; // 花在零超时poll上的时间
+            int64_t spinHits;         // 自旋期间等到了事件的次数
+            int64_t spinMisses;       // 自旋到预算用完也没等到 转去阻塞的次数
+            int64_t wakeups;          // 阻塞的poll被唤醒的次数(包括没开busy-poll时)
+            int64_t spinBudgetMicroSeconds; // 当前的自旋预算 自适应时会变
+        };
 
         EventLoop();
         ~EventLoop();
@@ -25,12 +40,34 @@ class EventLoop : noncopyable {
         // 退出事件循环
         void quit();
 
+        // 每轮epoll_wait返回后刷新一次的缓存时间 回调里直接读 不需要再取时钟
         Timestamp pollReturnTime() const { return pollReturnTime_; }
+        MonotonicTime pollReturnMonotonic() const { return pollReturnMonotonic_; }
+        // 已经poll了多少轮 只在loop线程读
+        int64_t iteration() const { return iteration_; }
+
+        // busy-poll: 阻塞在poll之前先用零超时的poll自旋最多spinMicroSeconds 省掉睡眠/唤醒的开销 0关闭
+        // adaptive时按上一次的结果调整预算: 自旋刚停事件就来了就加倍 阻塞了很久(空闲)就减半直到不自旋 省电
+        // 在loop线程里或loop()之前调用
+        void setBusyPoll(int64_t spinMicroSeconds, bool adaptive = true);
+        BusyPollStats busyPollStats() const;
 
         // 在当前loop中执行
         void runInLoop(Functor cb);
         // 把上层注册的回调函数cb放入队列中 唤醒loop所在的线程执行cb
         void queueInLoop(Functor cb);
+        // 本轮事件和pendingFunctors都处理完之后执行cb 只能在loop线程调用 用来把一轮里的小写合并成一次
+        void runAtIterationEnd(Functor cb);
+
+        // 定时器 线程安全 可在任意线程调用
+        // 在time时刻执行cb
+        TimerId runAt(Timestamp time, TimerCallback cb);
+        // delay秒后执行cb
+        TimerId runAfter(double delay, TimerCallback cb);
+        // 每隔interval秒执行一次cb
+        TimerId runEvery(double interval, TimerCallback cb);
+        // 取消定时器
+        void cancel(TimerId timerId);
 
         // 通过eventfd唤醒loop所在的线程
         void wakeup();
@@ -40,12 +77,32 @@ class EventLoop : noncopyable {
         void removeChannel(Channel *channel);
         bool hasChannel(Channel *channel);
 
+        // 负载计数 只有本loop线程写(不用加锁的RMW) 别的线程选loop时relaxed读 都是累计值 速率由读的一方自己算
+        void connectionAdded()
+        {
+            activeConnections_.store(activeConnections_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            establishedConnections_.store(establishedConnections_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        void connectionRemoved() { activeConnections_.store(activeConnections_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed); }
+        void addTransferred(size_t bytes) { bytesTransferred_.store(bytesTransferred_.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed); }
+        int64_t activeConnections() const { return activeConnections_.load(std::memory_order_relaxed); }
+        int64_t establishedConnections() const { return establishedConnections_.load(std::memory_order_relaxed); } // 累计建立过的
+        int64_t bytesTransferred() const { return bytesTransferred_.load(std::memory_order_relaxed); }
+        // 处理事件和回调花的时间(不含阻塞在poll里的时间)
+        int64_t busyMicroSeconds() const { return busyMicroSeconds_.load(std::memory_order_relaxed); }
+
+        // 本loop上连接的Buffer存储池 只能在loop线程里用
+        BufferPool *bufferPool() const { return bufferPool_.get(); }
+
         // 判断EventLoop对象是否在自己的线程里
         bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); } // threadId_为EventLoop创建时的线程id CurrentThread::tid()为当前线程id
 
     private:
         void handleRead();        // 给eventfd返回的文件描述符wakeupFd_绑定的事件回调 当wakeup()时 即有事件发生时 调用handleRead()读wakeupFd_的8字节 同时唤醒阻塞的epoll_wait
         void doPendingFunctors(); // 执行上层回调
+        void doIterationEndFunctors();
+        Timestamp busyPoll(); // 自旋 没等到就阻塞 结果放在activeChannels_
+        void adaptSpinBudget(bool hit, int64_t blockedMicroSeconds);
 
         using ChannelList = std::vector<Channel *>;
 
@@ -54,16 +111,35 @@ class EventLoop : noncopyable {
         std::atomic_bool quit_;    // 标识退出loop循环    
 
         const pid_t threadId_;  //记录这个EventLoop是哪个线程创建的
+        int64_t iteration_;
 
         Timestamp pollReturnTime_;  //poller poll检测到有事件发生的时间
+        MonotonicTime pollReturnMonotonic_; // 同一时刻的单调时间 算耗时用
         std::unique_ptr<Poller> poller_;  //一个EventLoop只有一个Poller, 一个Poller也只能被一个EventLoop拥有
+        std::unique_ptr<TimerQueue> timerQueue_; // 依赖poller_ 必须在它后面构造
 
         int wakeupFd_; // 作用：当mainLoop获取一个新用户的Channel 需通过轮询算法选择一个subLoop 通过该成员唤醒subLoop处理Channel
         std::unique_ptr<Channel> wakeupChannel_;
 
         ChannelList activeChannels_; // 返回Poller检测到当前有事件发生的所有Channel列表
 
+        std::unique_ptr<BufferPool> bufferPool_; // 要比pendingFunctors_活得久 队列里的回调可能还拿着连接
+
+        std::atomic<int64_t> activeConnections_;
+        std::atomic<int64_t> establishedConnections_;
+        std::atomic<int64_t> bytesTransferred_; // 读写的字节数
+        std::atomic<int64_t> busyMicroSeconds_;
+
+        int64_t maxSpinMicroSeconds_; // 0 表示没开busy-poll
+        bool adaptiveSpin_;
+        std::atomic<int64_t> spinBudgetMicroSeconds_;
+        std::atomic<int64_t> spinMicroSeconds_;
+        std::atomic<int64_t> spinHits_;
+        std::atomic<int64_t> spinMisses_;
+        std::atomic<int64_t> wakeups_;
+
         std::atomic_bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
-        std::vector<Functor> pendingFunctors_;    // 存储loop需要执行的所有回调操作
-        std::mutex mutex_;                        // 互斥锁 用来保护上面vector容器的线程安全操作
+        std::atomic_bool wakeupPending_;          // 已经有人写过eventfd 且loop还没开始处理 其他生产者不用再写
+        MpscQueue<Functor> pendingFunctors_;      // 存储loop需要执行的所有回调操作 无锁 多个线程同时投递不会互相阻塞
+        std::vector<Functor> iterationEndFunctors_; // 只在loop线程访问
 };
\ No newline at end of file
@@ -18,6 +18,9 @@ class EventLoopThread : noncopyable {
 
         ~EventLoopThread();
 
+        // 在startLoop之前调用 -1表示不管 线程一起来就先绑核/设内存节点 再构造EventLoop
+        void setPlacement(int cpu, int memoryNode) { cpu_ = cpu; memoryNode_ = memoryNode; }
+
         EventLoop *startLoop();
     private:
         void threadFunc();
@@ -28,5 +31,7 @@ class EventLoopThread : noncopyable {
         std::mutex mutex_;             // 互斥锁
         std::condition_variable cond_; // 条件变量
         ThreadInitCallback callback_;
+        int cpu_;
+        int memoryNode_;
 };
 
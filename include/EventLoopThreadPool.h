@@ -1,28 +1,54 @@
 #pragma once
 
+#include <stdint.h>
 #include <functional>
 #include <string>
 #include <vector>
 #include <memory>
 
 #include "noncopyable.h"
+#include "Timestamp.h"
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop *)>;
+    // 自定义选loop: 参数是所有IO loop和新连接的对端地址 返回其中一个
+    using LoopSelector = std::function<EventLoop *(const std::vector<EventLoop *> &, const InetAddress &)>;
+
+    // 新连接交给哪个subloop
+    enum LoopSelection {
+        kRoundRobin,        // 轮询
+        kLeastConnections,  // 当前连接数最少的
+        kPowerOfTwoChoices, // 随机挑两个 选负载(忙碌时间占比+流量占比+连接数占比)低的那个
+        kConsistentHash,    // 按对端IP一致性hash 同一个客户端的连接落在同一个loop 增减loop只影响一小部分
+    };
 
     EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg);
     ~EventLoopThreadPool();
 
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
 
+    // 线程放置 都在start之前调用
+    // 第i个IO loop绑到cpus[i % cpus.size()] 内存优先用那个CPU所在的节点
+    void setLoopCpus(const std::vector<int> &cpus) { loopCpus_ = cpus; }
+    // 没给CPU列表时IO loop依次绑到node的前几个核(跳过baseloop的核) 内存优先用这个节点
+    void setLoopNumaNode(int node) { numaNode_ = node; }
+    // baseloop(accept)单独绑一个核
+    void setBaseLoopCpu(int cpu) { baseLoopCpu_ = cpu; }
+    void setLoopSelection(LoopSelection selection) { selection_ = selection; }
+    // 设置之后优先于setLoopSelection
+    void setLoopSelector(const LoopSelector &selector) { selector_ = selector; }
+
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
     // 如果工作在多线程中，baseLoop_(mainLoop)会默认以轮询的方式分配Channel给subLoop
     EventLoop *getNextLoop();
+    // 按setLoopSelection/setLoopSelector的策略给新连接选loop 只能在baseloop线程里调用
+    EventLoop *getLoopForConnection(const InetAddress &peerAddr);
 
     std::vector<EventLoop *> getAllLoops(); // 获取所有的EventLoop
 
@@ -30,6 +56,24 @@ public:
     const std::string name() const { return name_; } // 获取名字
 
 private:
+    // 每个loop的负载采样 只在baseloop线程里访问
+    struct LoopLoad
+    {
+        int64_t assigned;      // 交给这个loop的连接数 减去loop已经建立的就是还在路上的
+        int64_t lastBytes;
+        int64_t lastBusyMicroSeconds;
+        double bytesPerSecond;
+        double busyFraction;
+    };
+
+    EventLoop *leastConnectionsLoop();
+    EventLoop *powerOfTwoChoicesLoop();
+    EventLoop *consistentHashLoop(const InetAddress &peerAddr);
+    int64_t pendingConnections(size_t index) const;
+    void sampleLoads();
+    double loadScore(size_t index, double totalConnections, double totalBytesPerSecond) const;
+    void buildHashRing();
+
     EventLoop *baseLoop_; // 用户使用muduo创建的loop 如果线程数为1 那直接使用用户创建的loop 否则创建多EventLoop
     std::string name_;//线程池名称，通常由用户指定，线程池中EventLoopThread名称依赖于线程池名称。
     bool started_;//是否已经启动标志
@@ -37,4 +81,15 @@ private:
     int next_; // 新连接到来，所选择EventLoop的索引
     std::vector<std::unique_ptr<EventLoopThread>> threads_;//IO线程的列表
     std::vector<EventLoop *> loops_;//线程池中EventLoop的列表，指向的是EVentLoopThread线程函数创建的EventLoop对象。
+
+    LoopSelection selection_;
+    LoopSelector selector_;
+    std::vector<LoopLoad> loads_; // 和loops_一一对应
+    MonotonicTime lastSample_;
+    uint64_t randomState_; // xorshift
+    std::vector<std::pair<uint32_t, size_t>> hashRing_; // (虚拟节点hash, loops_下标) 按hash排好序
+
+    std::vector<int> loopCpus_;
+    int numaNode_;    // -1 表示不管
+    int baseLoopCpu_; // -1 表示不管
 };
\ No newline at end of file
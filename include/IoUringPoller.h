@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <linux/io_uring.h>
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+/**
+ * 基于io_uring的Poller 直接用系统调用 不依赖liburing
+ * 1. io_uring_setup  创建SQ/CQ两个环 mmap到用户态
+ * 2. 注册/修改/删除fd关心的事件 = 往SQ里放IORING_OP_POLL_ADD/POLL_REMOVE 不需要系统调用
+ * 3. poll时一次io_uring_enter 既提交这一轮攒下的SQE 又等待CQE
+ *
+ * 普通channel用单次poll 触发后下一轮poll前重新挂上(重新挂时内核会检查当前状态) 和epoll的LT语义一致;
+ * 边沿触发的channel(Channel::isEdgeTriggered)用multishot poll, 一次POLL_ADD持续产生事件 连重新挂的SQE都省了
+ *
+ * CQE里的user_data = (generation << 32) | fd, fd重新注册时generation变化 旧的CQE直接丢掉
+ **/
+class IoUringPoller : public Poller
+{
+public:
+    explicit IoUringPoller(EventLoop *loop);
+    ~IoUringPoller() override;
+
+    // 内核不支持(没有io_uring或者太老)时为false 由newDefaultPoller退回epoll
+    bool valid() const { return ringFd_ >= 0; }
+
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+    void updateChannel(Channel *channel) override;
+    void removeChannel(Channel *channel) override;
+
+private:
+    static const unsigned kRingEntries = 1024;
+
+    struct Registration
+    {
+        Channel *channel;
+        uint32_t generation;
+        bool armed;        // 内核里是否有这个fd的poll请求
+        uint64_t batch;    // 最近一次放进activeChannels的轮次 multishot时合并同一轮的多个CQE
+    };
+
+    bool setupRing();
+    void closeRing();
+    io_uring_sqe *getSqe();
+    int submit(unsigned waitNr, int timeoutMs);
+
+    void arm(int fd, Registration &reg);
+    void disarm(int fd, Registration &reg);
+    void fillActiveChannels(ChannelList *activeChannels);
+
+    static uint64_t userData(int fd, uint32_t generation)
+    {
+        return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    bool multishot_; // 内核是否支持multishot poll(5.13+)
+    int ringFd_;
+
+    // SQ
+    void *sqRingPtr_;
+    size_t sqRingSize_;
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned *sqRingMask_;
+    unsigned *sqArray_;
+    io_uring_sqe *sqes_;
+    size_t sqesSize_;
+    unsigned sqEntries_;
+    unsigned toSubmit_; // 已经放进SQ还没提交的个数
+
+    // CQ
+    void *cqRingPtr_;
+    size_t cqRingSize_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned *cqRingMask_;
+    io_uring_cqe *cqes_;
+
+    uint32_t nextGeneration_;
+    uint64_t batch_;
+    std::unordered_map<int, Registration> registrations_;
+    std::vector<int> rearmFds_; // 单次poll触发过 下一轮poll前要重新挂上的fd
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+
+// 日志文件 按大小和日期滚动 只由AsyncLogging的后台线程使用 不加锁
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename, off_t rollSize, int flushInterval = 3);
+    ~LogFile();
+
+    void append(const char *logline, size_t len);
+    void flush();
+    // 换一个新文件写 同一秒内不会重复滚动
+    bool rollFile();
+
+private:
+    // basename.20250101-120000.hostname.pid.log
+    static std::string getLogFileName(const std::string &basename, time_t *now);
+
+    const std::string basename_;
+    const off_t rollSize_;    // 写满多少字节换文件
+    const int flushInterval_; // 多少秒flush一次
+
+    int count_;
+    time_t startOfPeriod_; // 当前文件所属的那一天 用来按天滚动
+    time_t lastRoll_;
+    time_t lastFlush_;
+
+    FILE *fp_;
+    off_t writtenBytes_;
+    char buffer_[64 * 1024]; // 给fp_用的用户态缓冲
+
+    static const int kCheckTimeEveryN = 1024; // 每写多少次检查一次时间
+    static const int kRollPerSeconds = 60 * 60 * 24;
+};
@@ -1,85 +1,107 @@
 #pragma once
-#include <string>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
 #include "noncopyable.h"
 
-// LOG_INFO("%s %d"， arg1, arg2)  s=字符串，d=十进制整数
-#define LOG_INFO(logmsgFormat, ...)                       \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(INFO);                         \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-    } while (0)
+// 编译期的日志下限 低于它的调用点直接展开成空语句 连参数都不会求值
+// 0=DEBUG 1=INFO 2=WARN 3=ERROR 4=FATAL, 可以用 -DMUDUO_MIN_LOG_LEVEL=2 覆盖
+#ifndef MUDUO_MIN_LOG_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_MIN_LOG_LEVEL 0
+#else
+#define MUDUO_MIN_LOG_LEVEL 1
+#endif
+#endif
 
-#define LOG_ERROR(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(ERROR);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+// 先检查运行时级别 没打开就什么都不做(一次relaxed原子读) 打开了才格式化
+#define LOG_IMPL(level, logmsgFormat, ...)                        \
+    do                                                            \
+    {                                                             \
+        if (Logger::enabled(level))                               \
+        {                                                         \
+            char buf[1024];                                       \
+            snprintf(buf, sizeof buf, logmsgFormat, ##__VA_ARGS__); \
+            Logger::instance().log(level, buf);                   \
+        }                                                         \
     } while (0)
 
-#define LOG_FATAL(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(FATAL);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-        exit(-1);                                         \
+#define LOG_NOOP(logmsgFormat, ...) \
+    do                              \
+    {                               \
     } while (0)
 
-#define LOG_WARN(logmsgFormat, ...)                       \
-    do {                                                  \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(WARN);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-        exit(-1);                                         \
-    } while (0)
+#if MUDUO_MIN_LOG_LEVEL <= 0
+#define LOG_DEBUG(logmsgFormat, ...) LOG_IMPL(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(logmsgFormat, ...) LOG_NOOP(logmsgFormat, ##__VA_ARGS__)
+#endif
 
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(DEBUG);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-    } while (0)
+// LOG_INFO("%s %d"， arg1, arg2)  s=字符串，d=十进制整数
+#if MUDUO_MIN_LOG_LEVEL <= 1
+#define LOG_INFO(logmsgFormat, ...) LOG_IMPL(INFO, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_INFO(logmsgFormat, ...) LOG_NOOP(logmsgFormat, ##__VA_ARGS__)
+#endif
+
+#if MUDUO_MIN_LOG_LEVEL <= 2
+#define LOG_WARN(logmsgFormat, ...) LOG_IMPL(WARN, logmsgFormat, ##__VA_ARGS__)
 #else
-#define LOG_DEBUG(logmsgFormat, ...)
+#define LOG_WARN(logmsgFormat, ...) LOG_NOOP(logmsgFormat, ##__VA_ARGS__)
 #endif
 
+#if MUDUO_MIN_LOG_LEVEL <= 3
+#define LOG_ERROR(logmsgFormat, ...) LOG_IMPL(ERROR, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(logmsgFormat, ...) LOG_NOOP(logmsgFormat, ##__VA_ARGS__)
+#endif
 
-// 定义日志的级别 INFO ERROR FATAL DEBUG
+// FATAL不受级别控制 打完日志直接退出
+#define LOG_FATAL(logmsgFormat, ...)                              \
+    do                                                            \
+    {                                                             \
+        char buf[1024];                                           \
+        snprintf(buf, sizeof buf, logmsgFormat, ##__VA_ARGS__);   \
+        Logger::instance().log(FATAL, buf);                       \
+        exit(-1);                                                 \
+    } while (0)
+
+// 定义日志的级别 从低到高 DEBUG INFO WARN ERROR FATAL
 enum LogLevel
 {
+    DEBUG, // 调试信息
     INFO,  // 普通信息
     WARN,  // 逻辑警告
     ERROR, // 错误信息
     FATAL, // core dump信息
-    DEBUG, // 调试信息
 };
 
 // 输出一个日志类
 class Logger : noncopyable
 {
 public:
+    // 格式化好的一整行交给输出函数 默认写stdout 可以换成AsyncLogging::append
+    using OutputFunc = void (*)(const char *msg, size_t len);
+    using FlushFunc = void (*)();
+
     // 获取日志唯一的实例对象 单例
     static Logger &instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+
+    // 运行时的最低输出级别 所有线程共享 原子变量 随时可以改
+    static void setLogLevel(int level) { s_logLevel_.store(level, std::memory_order_relaxed); }
+    static int logLevel() { return s_logLevel_.load(std::memory_order_relaxed); }
+    static bool enabled(int level) { return __builtin_expect(level >= logLevel(), 1); }
+
+    // 写日志 级别由每次调用传入 不再存到单例里
+    void log(int level, const char *msg);
+
+    void setOutput(OutputFunc out) { output_ = out; }
+    void setFlush(FlushFunc flush) { flush_ = flush; }
 
 private:
-    int logLevel_;
+    Logger();
+
+    static std::atomic<int> s_logLevel_;
+    OutputFunc output_;
+    FlushFunc flush_;
 };
\ No newline at end of file
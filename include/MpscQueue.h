@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include "noncopyable.h"
+
+/**
+ * 无锁多生产者单消费者队列 (Vyukov MPSC)
+ * 生产者: 一次原子exchange抢到队尾 再把前一个节点的next指向自己, 不需要锁也不会互相等待
+ * 消费者: 只有一个(loop线程) 从队头往后摘
+ *
+ *   head_(哑节点) -> n1 -> n2 -> ... -> tail_
+ *
+ * 生产者exchange之后、链上next之前被切走时, 消费者会暂时看不到它和它后面的节点,
+ * 这种情况由EventLoop的wakeup标志兜底: 生产者链好之后才检查标志, 消费者先清标志再消费
+ **/
+template <typename T>
+class MpscQueue : noncopyable
+{
+public:
+    MpscQueue()
+        : head_(new Node)
+        , tail_(head_)
+    {
+    }
+
+    ~MpscQueue()
+    {
+        while (head_)
+        {
+            Node *next = head_->next.load(std::memory_order_relaxed);
+            delete head_;
+            head_ = next;
+        }
+    }
+
+    // 任意线程
+    void push(T value)
+    {
+        Node *node = new Node(std::move(value));
+        Node *prev = tail_.exchange(node, std::memory_order_seq_cst);
+        prev->next.store(node, std::memory_order_seq_cst);
+    }
+
+    // 只在消费者线程调用
+    // 依次处理调用时已经入队的元素 处理过程中新入队的留到下一次 防止回调里不断入队导致一直出不来
+    template <typename F>
+    size_t consumeAll(F &&f)
+    {
+        Node *last = tail_.load(std::memory_order_seq_cst);
+        size_t count = 0;
+        while (head_ != last)
+        {
+            Node *next = head_->next.load(std::memory_order_seq_cst);
+            if (next == nullptr)
+            {
+                break; // 有生产者还没链上 下一轮再取
+            }
+            T value(std::move(next->value));
+            next->value = T(); // next变成新的哑节点 不再持有回调捕获的资源
+            delete head_;
+            head_ = next;
+            f(value);
+            ++count;
+        }
+        return count;
+    }
+
+    // 只在消费者线程调用
+    bool empty() const
+    {
+        return head_->next.load(std::memory_order_seq_cst) == nullptr;
+    }
+
+private:
+    struct Node
+    {
+        Node() : next(nullptr) {}
+        explicit Node(T v) : next(nullptr), value(std::move(v)) {}
+
+        std::atomic<Node *> next;
+        T value;
+    };
+
+    Node *head_;              // 消费者独占 指向哑节点
+    char pad_[64];            // 生产者频繁写tail_ 和消费者用的head_分开到不同cache line
+    std::atomic<Node *> tail_; // 生产者竞争
+};
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
@@ -28,10 +27,26 @@ class Poller {
         // EventLoop可以通过该接口获取默认的IO复用的具体实现
         static Poller *newDefaultPoller(EventLoop *loop);
 
+        // 可选的IO复用后端 也可以用环境变量MUDUO_USE_IOURING=1选io_uring
+        // io_uring不可用时自动退回epoll
+        enum Backend
+        {
+            kEpoll,
+            kIoUring,
+        };
+        // 之后新建的EventLoop都用这个后端 要在创建EventLoop(包括线程池)之前调用
+        static void setDefaultBackend(Backend backend);
+
     protected:
-        // map的key:sockfd value:sockfd所属的channel通道类型
-        using ChannelMap = std::unordered_map<int, Channel *>;
+        // 记录/删除fd对应的channel 子类在新加channel和removeChannel时调用
+        void addChannelEntry(Channel *channel);
+        void removeChannelEntry(Channel *channel);
+
+        // 下标是sockfd 值是sockfd所属的channel 没有就是nullptr
+        // fd是从小往上分配的稠密整数 直接按下标访问 不用hash 也不会有一大堆节点分散在堆上
+        using ChannelMap = std::vector<Channel *>;
         ChannelMap channels_;
+        size_t numChannels_;
 
     private:
         EventLoop *ownerLoop_; // 定义Poller所属的事件循环EventLoop
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "noncopyable.h"
+
+/**
+ * 槽位表: insert返回槽位下标 之后按下标O(1)取出 空出来的槽位用空闲栈复用 下标一直有效直到被取出
+ * 不是线程安全的 TcpServer里每个IO loop一个 只在那个loop线程里访问
+ **/
+template <typename T>
+class SlotMap : noncopyable
+{
+public:
+    SlotMap() : size_(0) {}
+
+    uint32_t insert(T value)
+    {
+        uint32_t slot;
+        if (!freeSlots_.empty())
+        {
+            slot = freeSlots_.back();
+            freeSlots_.pop_back();
+            slots_[slot].value = std::move(value);
+            slots_[slot].used = true;
+        }
+        else
+        {
+            slot = static_cast<uint32_t>(slots_.size());
+            slots_.push_back(Slot{std::move(value), true});
+        }
+        ++size_;
+        return slot;
+    }
+
+    // 槽位空着或者越界时返回nullptr
+    T *get(uint32_t slot)
+    {
+        return (slot < slots_.size() && slots_[slot].used) ? &slots_[slot].value : nullptr;
+    }
+
+    // 取出槽位里的对象 槽位留给下次insert
+    T take(uint32_t slot)
+    {
+        T value(std::move(slots_[slot].value));
+        slots_[slot].value = T();
+        slots_[slot].used = false;
+        freeSlots_.push_back(slot);
+        --size_;
+        return value;
+    }
+
+    // 取出全部对象 清空整个表
+    std::vector<T> takeAll()
+    {
+        std::vector<T> values;
+        values.reserve(size_);
+        for (Slot &slot : slots_)
+        {
+            if (slot.used)
+            {
+                values.push_back(std::move(slot.value));
+            }
+        }
+        slots_.clear();
+        freeSlots_.clear();
+        size_ = 0;
+        return values;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    struct Slot
+    {
+        T value;
+        bool used;
+    };
+
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeSlots_;
+    size_t size_;
+};
@@ -3,6 +3,7 @@
 #include "noncopyable.h"
 
 class InetAddress;
+struct sock_filter;
 
 // 封装socket fd
 class Socket : noncopyable
@@ -20,11 +21,24 @@ public:
     int accept(InetAddress *peeraddr);
 
     void shutdownWrite();
+    // 立刻断开连接(RST) 丢掉发送队列里还没发完/没确认的数据 fd不关
+    void abortConnection();
 
     void setTcpNoDelay(bool on);
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    // 监听socket: 三次握手完成后等到有数据(最多seconds秒)才让accept返回 0关闭 失败返回false
+    bool setDeferAccept(int seconds);
+    // 监听socket: 服务端TCP Fast Open queueLength是还没完成握手就带数据的连接最多排多少个 0关闭 失败返回false
+    bool setFastOpen(int queueLength);
+    // SO_BUSY_POLL: 读这个socket没数据时在网卡队列上忙轮询最多usec微秒 prefer时再开SO_PREFER_BUSY_POLL
+    // 调大到超过net.core.busy_read要CAP_NET_ADMIN 失败返回false
+    bool setBusyPoll(int usec, bool prefer);
+    // SO_ZEROCOPY 内核不支持时返回false
+    bool setZeroCopy(bool on);
+    // 给SO_REUSEPORT组挂一个经典BPF程序 返回值是组里第几个监听socket接这个连接 对整个组生效 失败返回false
+    bool attachReusePortCbpf(const struct sock_filter *code, unsigned short len);
 
 private:
     const int sockfd_;
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string.h>
+#include <string>
+
+// 只读的字符串视图 不拥有数据 (C++14没有std::string_view)
+// 可以从const char* / std::string / (指针, 长度) 隐式构造 用作send之类接口的参数
+class StringPiece
+{
+public:
+    StringPiece()
+        : ptr_(nullptr), length_(0) {}
+    StringPiece(const char *str)
+        : ptr_(str), length_(strlen(str)) {}
+    StringPiece(const std::string &str)
+        : ptr_(str.data()), length_(str.size()) {}
+    StringPiece(const char *offset, size_t len)
+        : ptr_(offset), length_(len) {}
+
+    const char *data() const { return ptr_; }
+    size_t size() const { return length_; }
+    bool empty() const { return length_ == 0; }
+
+    std::string as_string() const { return std::string(ptr_, length_); }
+
+private:
+    const char *ptr_;
+    size_t length_;
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 捕获shared_ptr<TcpConnection> + std::string + 成员函数指针的std::bind刚好在这个大小以内
+constexpr size_t kTaskInlineSize = 80;
+
+template <typename Signature, size_t InlineSize = kTaskInlineSize>
+class Task;
+
+/**
+ * 只能移动的回调类型 用来替代std::function
+ * std::function只有16字节左右的内联空间 并且要求可拷贝,
+ * runInLoop(std::bind(&TcpConnection::xxx, shared_from_this(), ...))这种回调每次都要堆分配
+ * Task把不超过InlineSize字节、移动构造不抛异常的可调用对象直接放在自己内部 超过了才退回堆上
+ * 只能移动: 投递到别的线程的回调本来就只执行一次 不需要拷贝 也就能捕获unique_ptr之类的对象
+ **/
+template <typename R, typename... Args, size_t InlineSize>
+class Task<R(Args...), InlineSize>
+{
+public:
+    Task() noexcept : ops_(nullptr) {}
+    Task(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename Fn = typename std::decay<F>::type,
+              typename = typename std::enable_if<!std::is_same<Fn, Task>::value>::type>
+    Task(F &&f)
+        : ops_(nullptr)
+    {
+        assign<Fn>(std::forward<F>(f));
+    }
+
+    Task(Task &&other) noexcept
+        : ops_(other.ops_)
+    {
+        if (ops_)
+        {
+            ops_->move(&other.storage_, &storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_)
+            {
+                other.ops_->move(&other.storage_, &storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task &operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    ~Task() { reset(); }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    R operator()(Args... args) const
+    {
+        return ops_->invoke(const_cast<Storage *>(&storage_), std::forward<Args>(args)...);
+    }
+
+private:
+    using Storage = typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type;
+
+    // 手写的虚表 每种可调用对象一份静态实例
+    struct Ops
+    {
+        R (*invoke)(Storage *, Args &&...);
+        void (*move)(Storage *from, Storage *to); // 移动到to 并析构from里的对象
+        void (*destroy)(Storage *);
+    };
+
+    template <typename Fn>
+    struct Inline
+    {
+        static Fn *get(Storage *s) { return reinterpret_cast<Fn *>(s); }
+        static R invoke(Storage *s, Args &&...args) { return (*get(s))(std::forward<Args>(args)...); }
+        static void move(Storage *from, Storage *to)
+        {
+            ::new (static_cast<void *>(to)) Fn(std::move(*get(from)));
+            get(from)->~Fn();
+        }
+        static void destroy(Storage *s) { get(s)->~Fn(); }
+    };
+
+    // 放不下的退回堆上 内部只存一个指针
+    template <typename Fn>
+    struct Heap
+    {
+        static Fn *&get(Storage *s) { return *reinterpret_cast<Fn **>(s); }
+        static R invoke(Storage *s, Args &&...args) { return (*get(s))(std::forward<Args>(args)...); }
+        static void move(Storage *from, Storage *to) { ::new (static_cast<void *>(to)) Fn *(get(from)); }
+        static void destroy(Storage *s) { delete get(s); }
+    };
+
+    template <typename Fn>
+    struct Fits
+        : std::integral_constant<bool,
+                                 sizeof(Fn) <= InlineSize &&
+                                     alignof(std::max_align_t) % alignof(Fn) == 0 &&
+                                     std::is_nothrow_move_constructible<Fn>::value>
+    {
+    };
+
+    template <typename Fn, typename F>
+    void assign(F &&f)
+    {
+        using Impl = typename std::conditional<Fits<Fn>::value, Inline<Fn>, Heap<Fn>>::type;
+        static const Ops ops = {&Impl::invoke, &Impl::move, &Impl::destroy};
+        if (isNull(f))
+        {
+            return; // 空的std::function/函数指针 保持为空
+        }
+        construct(std::forward<F>(f), Fits<Fn>());
+        ops_ = &ops;
+    }
+
+    template <typename F>
+    void construct(F &&f, std::true_type)
+    {
+        using Fn = typename std::decay<F>::type;
+        ::new (static_cast<void *>(&storage_)) Fn(std::forward<F>(f));
+    }
+
+    template <typename F>
+    void construct(F &&f, std::false_type)
+    {
+        using Fn = typename std::decay<F>::type;
+        ::new (static_cast<void *>(&storage_)) Fn *(new Fn(std::forward<F>(f)));
+    }
+
+    template <typename F>
+    static bool isNull(const F &f) { return isNullImpl(f, 0); }
+    template <typename F>
+    static auto isNullImpl(const F &f, int) -> decltype(f == nullptr) { return f == nullptr; }
+    template <typename F>
+    static bool isNullImpl(const F &, long) { return false; }
+
+    void reset() noexcept
+    {
+        if (ops_)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;
+    const Ops *ops_;
+};
@@ -1,18 +1,26 @@
 #pragma once
 
 #include <memory>
+#include <algorithm>
 #include <string>
 #include <atomic>
+#include <mutex>
+#include <initializer_list>
 
 #include "noncopyable.h"
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "ChainBuffer.h"
+#include "StringPiece.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
+#include "Task.h"
 
 class Channel;
 class EventLoop;
 class Socket;
+struct iovec;
 
 /**
  * TcpServer => Acceptor => 有一个新用户连接，通过accept函数拿到connfd
@@ -22,26 +30,87 @@ class Socket;
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
 {
 public:
+    // 零拷贝发送的数据 内核用完之后在loop线程里调用 负责释放数据
+    using ReleaseCallback = Task<void()>;
+    // 小于这个大小的零拷贝发送直接拷贝 页面pin住和完成通知的开销比拷贝还大
+    static const size_t kDefaultZeroCopyThreshold = 64 * 1024;
+
+    struct ZeroCopyStats
+    {
+        int64_t sends;        // MSG_ZEROCOPY发送次数
+        int64_t completions;  // 收到完成通知的发送次数
+        int64_t copied;       // 其中内核实际还是拷贝了的(回环/不支持的网卡)
+        size_t inflight;      // 还没收到通知的发送次数
+    };
+
+    // 名字是namePrefix + "#" + id 第一次调用name()时才拼出来 只打id的日志和不看名字的业务不用付这个开销
     TcpConnection(EventLoop *loop,
-                  const std::string &nameArg,
+                  uint64_t id,
+                  std::shared_ptr<const std::string> namePrefix,
                   int sockfd,
                   const InetAddress &localAddr,
                   const InetAddress &peerAddr);
     ~TcpConnection();
 
     EventLoop *getLoop() const { return loop_; }
-    const std::string &name() const { return name_; }
+    uint64_t id() const { return id_; }
+    const std::string &name() const; // 线程安全
     const InetAddress &localAddress() const { return localAddr_; }
     const InetAddress &peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
 
-    // 发送数据
-    void send(const std::string &buf);
-    void sendFile(int fileDescriptor, off_t offset, size_t count); 
+    // 发送数据 线程安全
+    // 在别的线程调用时: 指针/StringPiece版本会先拷贝一份 右值版本把数据直接移交给loop线程
+    // 没能立刻写完的部分进输出缓冲区 大块的string/Buffer整个接管 不再拷贝
+    void send(const void *data, size_t len);
+    void send(const StringPiece &message);
+    void send(const char *message) { send(StringPiece(message)); }
+    void send(std::string &&message);
+    void send(Buffer &&buf);
+    // 零拷贝发送 [data, data+len)在release被调用之前不能修改或释放
+    // 没开零拷贝或者len小于阈值时拷贝发送 拷贝完立刻release
+    void sendZeroCopy(const void *data, size_t len, ReleaseCallback release);
+    // 聚合发送 比如header + body 输出缓冲区为空时用一次writev发出去 不用先拼接
+    void send(std::initializer_list<StringPiece> fragments) { send(fragments.begin(), fragments.size()); }
+    void send(const StringPiece *fragments, size_t count);
+    // 发送文件的[offset, offset+count) 和前后send的数据保持顺序 全部发完才回调writeComplete
+    // fd由调用方持有 在writeComplete(或连接关闭)之前不能关闭
+    void sendFile(int fileDescriptor, off_t offset, size_t count);
     
     // 关闭半连接
     void shutdown();
+    // 直接关闭连接 不等对端 空闲超时时用
+    void forceClose();
+
+    // 设置所属loop的空闲时间轮 在connectEstablished之前调用
+    void setIdleWheel(TimingWheel *wheel) { idleWheel_ = wheel; }
+
+    // 边沿触发模式 在connectEstablished之前调用
+    // 每次事件一直读/写到EAGAIN, 单次读事件最多读readBudget字节 剩下的放到本轮末尾接着读 防止一个连接饿死别的连接
+    // readBudget为0时按1算 否则一次都不读 只会不停地把自己排到本轮末尾
+    void setEdgeTriggered(bool on, size_t readBudget)
+    { edgeTriggered_ = on; readBudget_ = std::max<size_t>(readBudget, 1); }
+
+    // 建立后不等poller通知 直接读一次 在connectEstablished之前调用
+    // 监听socket开了TCP_DEFER_ACCEPT/TCP_FASTOPEN时accept出来就已经有数据了 省一轮epoll
+    void setReadOnEstablish(bool on) { readOnEstablish_ = on; }
+
+    // 开启零拷贝发送 在connectEstablished之前或loop线程里调用 内核不支持时保持关闭
+    // 开启后不小于threshold的sendZeroCopy和右值send(string/Buffer)都走MSG_ZEROCOPY
+    void setZeroCopy(bool on, size_t threshold = kDefaultZeroCopyThreshold);
+    bool zeroCopy() const { return zeroCopy_; }
+    // 只在loop线程里调用
+    ZeroCopyStats zeroCopyStats() const;
+
+    // 自动合并小写(auto-cork) 在loop线程里调用
+    // 开启后同一轮里的send都先攒在输出缓冲区 本轮末尾用一次writev发出去 关闭时每次send立刻写(类似TCP_NODELAY)
+    void setAutoCork(bool on) { autoCork_ = on; }
+    bool autoCork() const { return autoCork_; }
+    // 关掉Nagle 小段立刻发出去
+    void setTcpNoDelay(bool on);
+    // 连接socket开SO_BUSY_POLL/SO_PREFER_BUSY_POLL 见Socket::setBusyPoll
+    bool setBusyPoll(int usec, bool prefer = true);
 
     void setConnectionCallback(const ConnectionCallback &cb)
     { connectionCallback_ = cb; }
@@ -53,6 +122,23 @@ public:
     { closeCallback_ = cb; }
     void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
     { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
+    // 输出缓冲区从lowWaterMark以上降到lowWaterMark及以下时回调 和高水位配对做端到端流控(比如代理恢复读上游)
+    void setLowWaterMarkCallback(const LowWaterMarkCallback &cb, size_t lowWaterMark)
+    { lowWaterMarkCallback_ = cb; lowWaterMark_ = lowWaterMark; }
+
+    // 读端背压 在loop线程里设置
+    // 输入缓冲区涨到high及以上时自动停止监听EPOLLIN并回调highCb 降到low及以下时自动恢复并回调lowCb
+    // 输入缓冲区只在messageCallback里被取走 暂停期间应用处理完积压后调用startRead() 会用缓冲区里的数据再回调一次messageCallback
+    void setInputWaterMarks(size_t high, size_t low,
+                            const HighWaterMarkCallback &highCb = HighWaterMarkCallback(),
+                            const LowWaterMarkCallback &lowCb = LowWaterMarkCallback())
+    { inputHighWaterMark_ = high; inputLowWaterMark_ = low; inputHighWaterMarkCallback_ = highCb; inputLowWaterMarkCallback_ = lowCb; }
+
+    // 开始/停止读 线程安全 停止期间内核接收缓冲区满了对端就发不动了
+    // startRead时输入缓冲区里还有数据就先回调一次messageCallback
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; } // 应用要求的状态 不含水位造成的暂停
 
     // 连接建立
     void connectEstablished();
@@ -70,17 +156,64 @@ private:
     void setState(StateE state) { state_ = state; }
 
     void handleRead(Timestamp receiveTime);
+    void handleReadEdgeTriggered(Timestamp receiveTime);
     void handleWrite();//处理写事件
+    void startReadInLoop();
+    void stopReadInLoop();
+    // 按reading_和水位暂停状态开关EPOLLIN
+    void updateReading();
+    // messageCallback之后检查输入缓冲区的高低水位
+    void checkInputWaterMarks();
+    // 输出缓冲区写出去一部分之后检查低水位
+    void outputRetrieved(size_t oldLen);
     void handleClose();
     void handleError();
 
+    // 输出缓冲区里还有数据在排队 新数据不能直接write
+    bool writingBlocked() const;
     void sendInLoop(const void *data, size_t len);
+    void sendStringInLoop(std::string &message);
+    void sendBufferInLoop(Buffer &buf);
+    void sendFragmentsInLoop(const StringPiece *fragments, size_t count);
+    void sendZeroCopyInLoop(const void *data, size_t len, ReleaseCallback &release);
+    // 从错误队列读零拷贝的完成通知
+    void handleZeroCopyCompletions();
+    // 连接销毁后等所有零拷贝发送的完成通知都到了 再放掉连接(关fd 调用release)
+    // 过了deadline还没等到就RST掉连接 再等一小会儿 还没有就放弃(ChainBuffer析构时泄漏这些数据)
+    void drainZeroCopy(MonotonicTime deadline, bool aborted);
+    // 输出缓冲区里没有排队的数据时直接写socket 返回写出去的字节数 对端已经断开时faultError置true
+    size_t sendDirectly(const struct iovec *vec, int iovcnt, size_t total, bool *faultError);
+    // 没写完的数据进了输出缓冲区之后 检查高水位 注册EPOLLOUT
+    void outputQueued(size_t oldLen);
+    // 输出缓冲区写空了 下一轮回调writeComplete(那时缓冲区还是空的才回调)
+    void queueWriteComplete();
+    void writeCompleteInLoop();
+    // 刚追加进输出缓冲区的零拷贝/文件段 之前没有数据排队就马上写一次 写不完再等EPOLLOUT
+    void writeAppended(size_t oldLen, bool blocked);
+    // 写一次输出缓冲区 写空了或者连接已经不能写了返回true
+    bool flushOutput();
+    // auto-cork 本轮末尾把攒下的数据写出去
+    void flushCorked();
     void shutdownInLoop();
+    void forceCloseInLoop();
     void sendFileInLoop(int fileDescriptor, off_t offset, size_t count);
     EventLoop *loop_; // 这里是baseloop还是subloop由TcpServer中创建的线程数决定 若为多Reactor 该loop_指向subloop 若为单Reactor 该loop_指向baseloop
-    const std::string name_;
+    const uint64_t id_;
+    const std::shared_ptr<const std::string> namePrefix_;
+    mutable std::once_flag nameOnce_;
+    mutable std::string name_;
     std::atomic_int state_;
-    bool reading_;//连接是否在监听读事件
+    bool reading_;//应用是否要求读 stopRead后为false
+    bool inputPaused_; // 输入缓冲区到了高水位 暂停读
+    bool edgeTriggered_; // EPOLLET 读写都到EAGAIN为止 EPOLLOUT一直注册着
+    size_t readBudget_;  // ET模式下单次读事件最多读多少字节
+    bool zeroCopy_;
+    size_t zeroCopyThreshold_;
+    int64_t zeroCopyCompletions_;
+    int64_t zeroCopyCopied_;
+    bool autoCork_;
+    bool corkFlushPending_; // 已经登记了本轮末尾的flush
+    bool readOnEstablish_;
 
     // Socket Channel 这里和Acceptor类似    Acceptor => mainloop    TcpConnection => subloop
     std::unique_ptr<Socket> socket_;
@@ -96,8 +229,17 @@ private:
     HighWaterMarkCallback highWaterMarkCallback_; // 高水位回调
     CloseCallback closeCallback_; // 关闭连接的回调
     size_t highWaterMark_; // 高水位阈值
+    LowWaterMarkCallback lowWaterMarkCallback_;
+    size_t lowWaterMark_;
+    HighWaterMarkCallback inputHighWaterMarkCallback_;
+    LowWaterMarkCallback inputLowWaterMarkCallback_;
+    size_t inputHighWaterMark_; // 默认不限
+    size_t inputLowWaterMark_;
+
+    TimingWheel *idleWheel_;          // 为空表示不做空闲超时
+    TimingWheel::Entry idleEntry_;    // 在时间轮中的节点
 
     // 数据缓冲区
     Buffer inputBuffer_;    // 接收数据的缓冲区
-    Buffer outputBuffer_;   // 发送数据的缓冲区 用户send向outputBuffer_发
+    ChainBuffer outputBuffer_; // 发送数据的缓冲区 用户send向outputBuffer_发 slab链 追加不搬数据 writev发送
 };
@@ -14,6 +14,7 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "SlotMap.h"
 
 class TcpServer {
 
@@ -24,6 +25,15 @@ class TcpServer {
         enum Option {
             kNoReusePort,
             KReusePort,
+            // 每个IO loop自己一个SO_REUSEPORT监听socket 在自己线程里accept 新连接留在本loop 不用跨线程交接
+            // 没有IO线程时和KReusePort一样 只有baseloop accept
+            kReusePortPerLoop,
+        };
+
+        // kReusePortPerLoop时内核把新连接分给哪个loop的监听socket
+        enum AcceptSteering {
+            kHashSteering, // 内核默认 按四元组hash
+            kCpuSteering,  // 挂一个CBPF程序 处理SYN的CPU为c时交给第(c % loop数)个loop 配合IO线程绑核和网卡RSS使用
         };
 
         TcpServer(EventLoop *loop, 
@@ -33,10 +43,54 @@ class TcpServer {
         ~TcpServer();
 
         void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+        // 下面三个回调和其余连接设置一样 在start时定下来 之后再改不影响新连接
         void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
         void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
         void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
 
+        // 空闲超过seconds秒的连接会被关闭 tickSeconds是检查精度 在start之前调用
+        void setIdleTimeout(double seconds, double tickSeconds = 1.0)
+        { idleTimeout_ = seconds; idleTick_ = tickSeconds; }
+
+        // 连接用边沿触发(EPOLLET) 读写都到EAGAIN为止 readBudget是单次读事件最多读的字节数(0按1算) 在start之前调用
+        void setEdgeTriggered(bool on, size_t readBudget = 1024 * 1024)
+        { edgeTriggered_ = on; readBudget_ = std::max<size_t>(readBudget, 1); }
+
+        // 连接开启零拷贝发送(SO_ZEROCOPY) 不小于threshold字节的sendZeroCopy/右值send走MSG_ZEROCOPY 在start之前调用
+        void setZeroCopy(bool on, size_t threshold = TcpConnection::kDefaultZeroCopyThreshold)
+        { zeroCopy_ = on; zeroCopyThreshold_ = threshold; }
+
+        // 新连接默认开启auto-cork 同一轮里的小send合并成一次writev 单个连接可以再用TcpConnection::setAutoCork关掉 在start之前调用
+        void setAutoCork(bool on) { autoCork_ = on; }
+
+        // 在start之前调用 只对kReusePortPerLoop有效
+        void setAcceptSteering(AcceptSteering steering) { acceptSteering_ = steering; }
+
+        // baseloop accept的新连接交给哪个subloop 默认轮询 kReusePortPerLoop时连接留在accept它的loop 不看这个设置
+        void setLoopSelection(EventLoopThreadPool::LoopSelection selection) { threadPool_->setLoopSelection(selection); }
+        void setLoopSelector(const EventLoopThreadPool::LoopSelector &selector) { threadPool_->setLoopSelector(selector); }
+
+        // 一次可读事件最多accept多少个连接 在start之前调用
+        void setAcceptBatch(int batch) { acceptBatch_ = batch; }
+
+        // 同时最多maxConnections个连接 到了上限暂停accept(新连接留在内核队列里) 有连接关掉再恢复 在start之前调用
+        // 每个loop自己accept时只暂停到上限的那个loop的监听socket 别的loop再accept到的会被直接关掉并暂停
+        void setMaxConnections(int maxConnections) { maxConnections_ = maxConnections; }
+
+        // 监听socket开TCP_DEFER_ACCEPT 握手后最多等seconds秒 客户端发来数据才accept 适合客户端先说话的协议 在start之前调用
+        void setDeferAccept(int seconds) { deferAcceptSeconds_ = seconds; }
+        // 监听socket开服务端TCP Fast Open queueLength是TFO连接的排队上限 在start之前调用
+        void setFastOpen(int queueLength) { fastOpenQueue_ = queueLength; }
+
+        // IO loop绑核/NUMA节点 baseloop单独绑核 见EventLoopThreadPool 在start之前调用
+        void setLoopCpus(const std::vector<int> &cpus) { threadPool_->setLoopCpus(cpus); }
+        void setLoopNumaNode(int node) { threadPool_->setLoopNumaNode(node); }
+        void setBaseLoopCpu(int cpu) { threadPool_->setBaseLoopCpu(cpu); }
+
+        // 所有IO loop开busy-poll(见EventLoop::setBusyPoll) socketBusyPollUs > 0时新连接再开SO_BUSY_POLL 在start之前调用
+        void setBusyPoll(int64_t spinMicroSeconds, bool adaptive = true, int socketBusyPollUs = 0)
+        { busyPollSpinUs_ = spinMicroSeconds; busyPollAdaptive_ = adaptive; socketBusyPollUs_ = socketBusyPollUs; }
+
         // 设置底层subloop的个数
         void setThreadNum(int numThreads);
         /**
@@ -48,19 +102,79 @@ class TcpServer {
 
     private:
 
-        void newConnection(int sockfd, const InetAddress &peerAddr);
-        void removeConnection(const TcpConnectionPtr &conn);
-        void removeConnectionInLoop(const TcpConnectionPtr &conn);
+        // 一个IO loop上的所有连接 只在那个loop线程里访问
+        // 连接的关闭回调直接持有它 建立/关闭/销毁都在所属loop里完成 不经过baseloop 也不碰TcpServer
+        // 连接数上限 连接的关闭回调也持有它 TcpServer析构后server置空
+        struct ConnectionLimit
+        {
+            std::atomic<int> connections;
+            int maxConnections;
+            EventLoop *baseLoop;
+            TcpServer *server; // 只在baseloop里读写
+        };
+        using LimitPtr = std::shared_ptr<ConnectionLimit>;
+
+        // 新连接的设置 start时定下来 之后只读
+        struct ConnectionOptions
+        {
+            std::shared_ptr<const std::string> namePrefix;
+            ConnectionCallback connectionCallback;
+            MessageCallback messageCallback;
+            WriteCompleteCallback writeCompleteCallback;
+            bool edgeTriggered;
+            size_t readBudget;
+            bool zeroCopy;
+            size_t zeroCopyThreshold;
+            bool autoCork;
+            bool readOnEstablish;
+            int socketBusyPollUs;
+        };
+        using OptionsPtr = std::shared_ptr<const ConnectionOptions>;
+
+        struct ConnectionShard
+        {
+            EventLoop *loop;
+            SlotMap<TcpConnectionPtr> connections;
+            LimitPtr limit; // 没设上限时为空
+            OptionsPtr options;
+            std::shared_ptr<TimingWheel> idleWheel; // 没设空闲超时时为空
+        };
+        using ShardPtr = std::shared_ptr<ConnectionShard>;
 
-        using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+        // baseloop上的Acceptor: 按选loop策略选一个IO loop
+        void newConnection(int sockfd, const InetAddress &peerAddr);
+        // 每个loop自己的Acceptor 这时已经在ioLoop线程里了
+        void newLoopConnection(Acceptor *acceptor, EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+        void createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+        // 在accept的线程里调用 超过上限时关掉sockfd返回false 到了上限暂停acceptor
+        bool admitConnection(Acceptor *acceptor, int sockfd);
+        void resumeAccepting();
+        // 按设置配置监听socket 返回TCP_DEFER_ACCEPT/TFO是否有设置成功的 有的话新连接建立时直接读
+        bool setupListenSocket(Acceptor *acceptor);
+        // kReusePortPerLoop: 每个loop建一个Acceptor并配置好 全部配置好之后再按loop顺序listen
+        bool createLoopAcceptors();
+        void listenLoopAcceptors();
+        // 在ioLoop线程里构造TcpConnection 连接对象和它的Channel/Socket/缓冲区都在IO线程里分配 跟着它的NUMA节点
+        static void newConnectionInLoop(const ShardPtr &shard, uint64_t connId, int sockfd,
+                                        const InetAddress &localAddr, const InetAddress &peerAddr);
+        static void connectEstablishedInLoop(const ShardPtr &shard, const TcpConnectionPtr &conn);
+
+        using ShardMap = std::unordered_map<EventLoop *, ShardPtr>;
+        using IdleWheelMap = std::unordered_map<EventLoop *, std::shared_ptr<TimingWheel>>;
 
         EventLoop *loop_; // baseloop 用户自定义的loop
 
+        const InetAddress listenAddr_;
         const std::string ipPort_;
         const std::string name_;
+        const std::shared_ptr<const std::string> connNamePrefix_; // name-ip:port 所有连接共用
 
-        std::unique_ptr<Acceptor> acceptor_; // 运行在mainloop 任务就是监听新连接事件
+        std::unique_ptr<Acceptor> acceptor_; // 运行在mainloop 任务就是监听新连接事件 每个loop自己accept时不listen
+        const bool perLoopAccept_;
+        AcceptSteering acceptSteering_;
+        std::vector<std::unique_ptr<Acceptor>> loopAcceptors_; // 和getAllLoops()一一对应 各自在自己的loop里析构
 
+        IdleWheelMap idleWheels_; // 每个IO loop一个时间轮 start之后只读; 必须在threadPool_之前声明 保证loop线程先退出
         std::shared_ptr<EventLoopThreadPool> threadPool_; // one loop per thread
 
         ConnectionCallback connectionCallback_;       //有新连接时的回调
@@ -70,6 +184,21 @@ class TcpServer {
         ThreadInitCallback threadInitCallback_; // loop线程初始化的回调
         int numThreads_;//线程池中线程的数量。
         std::atomic_int started_;
-        int nextConnId_;
-        ConnectionMap connections_; // 保存所有的连接
+        std::atomic<uint64_t> nextConnId_; // 每个loop自己accept时多个线程同时分配
+        double idleTimeout_; // <= 0 表示不检查空闲连接
+        double idleTick_;
+        bool edgeTriggered_;
+        size_t readBudget_;
+        bool zeroCopy_;
+        size_t zeroCopyThreshold_;
+        bool autoCork_;
+        int acceptBatch_;
+        int maxConnections_; // <= 0 表示不限
+        int deferAcceptSeconds_; // 0 表示不开
+        int fastOpenQueue_;      // 0 表示不开
+        int64_t busyPollSpinUs_; // 0 表示不开
+        bool busyPollAdaptive_;
+        int socketBusyPollUs_;
+        LimitPtr limit_;
+        ShardMap shards_; // 每个IO loop一个连接表 start之后只读
 };
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// 线程放到哪个核/哪个NUMA节点 都只作用于调用线程 失败时打WARN返回false 不影响运行
+namespace ThreadPlacement
+{
+    // 绑到一个CPU上 不让调度器迁移
+    bool pinCurrentThread(int cpu);
+    // 之后这个线程新分配(第一次写)的内存优先从node上拿
+    bool preferMemoryNode(int node);
+    // node上的CPU列表 读/sys/devices/system/node/nodeN/cpulist 没有这个节点时返回空
+    std::vector<int> nodeCpus(int node);
+    // cpu属于哪个节点 不知道时返回-1
+    int cpuNode(int cpu);
+    // pthread_setname_np 超过15个字符时截掉前缀 末尾的编号保留 top -H/perf里看得到
+    void setCurrentThreadName(const std::string &name);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+/**
+ * 每个EventLoop一个TimerQueue:
+ * 所有定时器按到期时间放在std::set里(红黑树 增删O(logn))
+ * 只把最早到期的那个时间设置给timerfd, timerfd可读时由timerfdChannel_回调handleRead
+ * 到期的定时器在loop线程里执行, 所以定时回调和IO回调不会并发
+ **/
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 线程安全 可以在任意线程调用
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    void cancel(TimerId timerId);
+
+    size_t size() const { return timers_.size(); }
+
+private:
+    // Timer*相同时用到期时间区分 所以key是pair
+    using Entry = std::pair<Timestamp, Timer *>;
+    using TimerList = std::set<Entry>;
+    // 按地址+序号索引 cancel时用
+    using ActiveTimer = std::pair<Timer *, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+
+    // timerfd可读时的回调
+    void handleRead();
+
+    // 取出所有到期的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    // 重复的定时器重新插入 一次性的删掉
+    void reset(const std::vector<Entry> &expired, Timestamp now);
+
+    // 插入定时器 返回最早到期时间是否改变
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    TimerList timers_; // 按到期时间排序
+
+    ActiveTimerSet activeTimers_;
+    bool callingExpiredTimers_; // 正在执行到期回调
+    ActiveTimerSet cancelingTimers_; // 执行回调期间被取消的定时器 防止重复定时器被重新插入
+};
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <string>
 
+// 墙上时间 微秒精度 用于打日志/定时器/receiveTime
 class Timestamp
 {
 public:
@@ -10,7 +11,79 @@ public:
     explicit Timestamp(int64_t microSecondsSinceEpoch);
     static Timestamp now();
     std::string toString() const;
+    // 2025/01/01 12:00:00.123456
+    std::string toFormattedString(bool showMicroseconds = true) const;
+
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator!=(Timestamp lhs, Timestamp rhs) { return !(lhs == rhs); }
+inline bool operator>(Timestamp lhs, Timestamp rhs) { return rhs < lhs; }
+inline bool operator<=(Timestamp lhs, Timestamp rhs) { return !(rhs < lhs); }
+inline bool operator>=(Timestamp lhs, Timestamp rhs) { return !(lhs < rhs); }
+
+// high - low 单位秒
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 在timestamp的基础上加上seconds秒 定时器用它计算到期时间
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
+
+// 单调时钟(CLOCK_MONOTONIC) 不受改系统时间/NTP跳变影响 只用来计算时间间隔
+class MonotonicTime
+{
+public:
+    MonotonicTime() : microSeconds_(0) {}
+    explicit MonotonicTime(int64_t microSeconds) : microSeconds_(microSeconds) {}
+    static MonotonicTime now();
+
+    int64_t microSeconds() const { return microSeconds_; }
+    bool valid() const { return microSeconds_ > 0; }
+
+private:
+    int64_t microSeconds_; // 开机以来的微秒数
+};
+
+inline bool operator<(MonotonicTime lhs, MonotonicTime rhs)
+{
+    return lhs.microSeconds() < rhs.microSeconds();
+}
+
+inline bool operator==(MonotonicTime lhs, MonotonicTime rhs)
+{
+    return lhs.microSeconds() == rhs.microSeconds();
+}
+
+inline double timeDifference(MonotonicTime high, MonotonicTime low)
+{
+    return static_cast<double>(high.microSeconds() - low.microSeconds()) / Timestamp::kMicroSecondsPerSecond;
+}
+
+inline MonotonicTime addTime(MonotonicTime time, double seconds)
+{
+    return MonotonicTime(time.microSeconds() + static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond));
+}
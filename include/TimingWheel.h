@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+class EventLoop;
+
+/**
+ * 空闲连接超时用的时间轮 每个IO loop一个 只在所属loop线程中访问 所以不需要锁
+ *
+ * buckets_[i]是一个侵入式双向链表 节点Entry直接放在TcpConnection里 增删不分配内存
+ * 连接活跃时只更新Entry::lastActiveTick (touch, O(1)), 不移动链表节点;
+ * tick转到某个槽时才检查里面的连接: 确实超时的批量关闭, 期间活跃过的挪到新的到期槽里(惰性下沉)
+ **/
+class TimingWheel : noncopyable, public std::enable_shared_from_this<TimingWheel>
+{
+public:
+    struct Entry
+    {
+        Entry()
+            : prev(nullptr)
+            , next(nullptr)
+            , lastActiveTick(0)
+            , conn(nullptr)
+        {
+        }
+
+        bool linked() const { return next != nullptr; }
+
+        Entry *prev;
+        Entry *next;
+        int64_t lastActiveTick; // 最近一次活跃时的tick
+        TcpConnection *conn;
+    };
+
+    // idleSeconds: 空闲多久算超时  tickSeconds: 时间轮每格的精度
+    TimingWheel(EventLoop *loop, double idleSeconds, double tickSeconds);
+    ~TimingWheel();
+
+    // 开始转动 线程安全 定时回调只持有weak_ptr, TcpServer析构后不会访问到已释放的时间轮
+    void start();
+
+    // 以下只能在loop线程中调用
+    void add(Entry *entry, TcpConnection *conn);
+    void remove(Entry *entry);
+    void touch(Entry *entry) { entry->lastActiveTick = currentTick_; }
+
+    size_t size() const { return size_; }
+
+private:
+    void onTick();
+    void link(Entry *entry, int64_t deadlineTick);
+    static void unlink(Entry *entry);
+
+    EventLoop *loop_;
+    const double tickSeconds_;
+    const int64_t idleTicks_;     // 超时对应的格数
+    std::vector<Entry> buckets_;  // 每个槽的链表头(哨兵) 构造后不再扩容 否则链表指针会失效
+    int64_t currentTick_;
+    size_t size_;
+};
@@ -1,11 +1,13 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include "Acceptor.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "EventLoop.h"
 
 static int createNonblocking()
 {
@@ -22,41 +24,143 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     , acceptSocket_(createNonblocking())
     , acceptChannel_(loop, acceptSocket_.fd())
     , listenning_(false)
+    , paused_(false)
+    , backingOff_(false)
+    , acceptBatch_(kDefaultAcceptBatch)
+    , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
 {
+    if (idleFd_ < 0)
+    {
+        LOG_ERROR("%s:%s:%d open /dev/null err:%d, will retry on EMFILE\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr);
 
     acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
 }
 
 Acceptor::~Acceptor(){
+    if (backingOff_) {
+        loop_->cancel(backOffTimer_);
+    }
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    if (idleFd_ >= 0) {
+        ::close(idleFd_);
+    }
 }
 
 void Acceptor::listen()
 {
     listenning_ = true;
     acceptSocket_.listen();         // listen
-    acceptChannel_.enableReading(); // acceptChannel_注册至Poller !重要
+    if (!paused_ && !backingOff_) {
+        acceptChannel_.enableReading(); // acceptChannel_注册至Poller !重要
+    }
+}
+
+void Acceptor::pause()
+{
+    if (!paused_) {
+        paused_ = true;
+        if (listenning_ && !backingOff_) {
+            acceptChannel_.disableReading();
+        }
+    }
+}
+
+void Acceptor::resume()
+{
+    if (paused_) {
+        paused_ = false;
+        if (listenning_ && !backingOff_) {
+            acceptChannel_.enableReading();
+        }
+    }
+}
+
+void Acceptor::backOff()
+{
+    if (backingOff_) {
+        return;
+    }
+    backingOff_ = true;
+    if (!paused_) {
+        acceptChannel_.disableReading();
+    }
+    backOffTimer_ = loop_->runAfter(kBackOffSeconds, [this]() {
+        backingOff_ = false;
+        if (listenning_ && !paused_) {
+            acceptChannel_.enableReading();
+        }
+    });
+}
+
+bool Acceptor::shedOne(bool *queueEmpty)
+{
+    if (idleFd_ < 0) {
+        // 上次没能重新打开 再试一次 可能已经有fd释放了
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (idleFd_ < 0) {
+            return false;
+        }
+    }
+    ::close(idleFd_);
+    int shed = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+    if (shed >= 0) {
+        ::close(shed);
+    }
+    *queueEmpty = shed < 0; // accept4先分配fd再看队列 队列空了也会报EMFILE
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (idleFd_ < 0) {
+        // fd被别的线程抢走了 下次EMFILE时再试
+        LOG_ERROR("%s:%s:%d reopen /dev/null err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return true;
 }
 
 
 void Acceptor::handleRead()
 {
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0) {
-        if (NewConnectionCallback_) {
-            NewConnectionCallback_(connfd, peerAddr);
-        } else {
-            ::close(connfd);
+    // 一次把全连接队列里的连接取出来 到EAGAIN 或者到batch个 或者回调里把自己暂停了为止
+    for (int i = 0; i < acceptBatch_ && !paused_; ++i) {
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0) {
+            if (NewConnectionCallback_) {
+                NewConnectionCallback_(connfd, peerAddr);
+            } else {
+                ::close(connfd);
+            }
+            continue;
         }
-    } else {
-        LOG_ERROR("%s:%s:%d accept err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
-        if (errno == EMFILE) {
-            LOG_ERROR("%s:%s:%d sockfd reached limit\n", __FILE__, __FUNCTION__, __LINE__);
+
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
+            break;
+        }
+        if (savedErrno == ECONNABORTED || savedErrno == EINTR || savedErrno == EPROTO) {
+            continue; // 这个连接在accept之前就断了 接着取下一个
         }
+        if (savedErrno == EMFILE || savedErrno == ENFILE) {
+            // 不取走的话监听socket一直可读 loop会空转到100% CPU
+            // 用预留的fd把它accept下来马上关掉 客户端会收到FIN 而不是一直挂着
+            LOG_ERROR("%s:%s:%d sockfd reached limit, shedding connection\n", __FILE__, __FUNCTION__, __LINE__);
+            bool queueEmpty = false;
+            if (!shedOne(&queueEmpty)) {
+                // 连预留fd都没有 拒绝不了 先停一会儿 等fd降下来
+                LOG_ERROR("%s:%s:%d no spare fd to shed with, accept paused for %.0f ms\n",
+                          __FILE__, __FUNCTION__, __LINE__, kBackOffSeconds * 1000);
+                backOff();
+                break;
+            }
+            if (queueEmpty) {
+                break;
+            }
+            continue;
+        }
+        LOG_ERROR("%s:%s:%d accept err:%d\n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+        break;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <chrono>
+
+#include "AsyncLogging.h"
+#include "LogFile.h"
+#include "Timestamp.h"
+
+AsyncLogging::AsyncLogging(const std::string &basename,
+                           off_t rollSize,
+                           int flushInterval,
+                           size_t maxPendingBuffers)
+    : flushInterval_(flushInterval)
+    , basename_(basename)
+    , rollSize_(rollSize)
+    , maxPendingBuffers_(maxPendingBuffers)
+    , running_(false)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "AsyncLogging")
+    , currentBuffer_(new LogBuffer)
+    , nextBuffer_(new LogBuffer)
+    , droppedLines_(0)
+{
+    buffers_.reserve(maxPendingBuffers_);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    stop();
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        // 和后台线程判断是否要睡下去在同一把锁里 否则通知可能丢 要多等一个flushInterval
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return; // 没start过 或者已经stop过了
+        }
+        running_ = false;
+        cond_.notify_one();
+    }
+    thread_.join();
+}
+
+void AsyncLogging::append(const char *logline, size_t len)
+{
+    // 一整块都放不下的超长行 截到刚好占满一块 换行补回去 后面的日志不会粘在这行上
+    bool truncated = len > LogBuffer::kSize;
+    if (truncated)
+    {
+        len = LogBuffer::kSize - 1;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (currentBuffer_->avail() > len)
+    {
+        currentBuffer_->append(logline, len);
+        if (truncated)
+        {
+            currentBuffer_->append("\n", 1);
+        }
+        return;
+    }
+
+    // 后台写不过来 积压到上限就丢掉 防止内存无限增长
+    if (buffers_.size() >= maxPendingBuffers_)
+    {
+        ++droppedLines_;
+        return;
+    }
+
+    buffers_.push_back(std::move(currentBuffer_));
+    if (nextBuffer_)
+    {
+        currentBuffer_ = std::move(nextBuffer_);
+    }
+    else
+    {
+        currentBuffer_.reset(new LogBuffer); // 很少发生 两块都用完了
+    }
+    currentBuffer_->append(logline, len);
+    if (truncated)
+    {
+        currentBuffer_->append("\n", 1);
+    }
+    cond_.notify_one();
+}
+
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, flushInterval_);
+    // 后台线程自己准备两块空闲块 换给前端 减少前端分配
+    BufferPtr newBuffer1(new LogBuffer);
+    BufferPtr newBuffer2(new LogBuffer);
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(maxPendingBuffers_ + 1);
+    size_t reportedDrops = 0;
+
+    while (running_)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (buffers_.empty() && running_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if (!nextBuffer_)
+            {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+        }
+
+        size_t drops = droppedLines_;
+        if (drops != reportedDrops)
+        {
+            char buf[256];
+            int len = snprintf(buf, sizeof buf, "%s AsyncLogging dropped %lu log lines so far\n",
+                               Timestamp::now().toFormattedString().c_str(), drops);
+            output.append(buf, len);
+            reportedDrops = drops;
+        }
+
+        for (const BufferPtr &buffer : buffersToWrite)
+        {
+            output.append(buffer->data(), buffer->length());
+        }
+
+        // 留两块回收给newBuffer1/2 其余释放
+        if (buffersToWrite.size() > 2)
+        {
+            buffersToWrite.resize(2);
+        }
+        if (!newBuffer1)
+        {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+        if (!newBuffer2 && !buffersToWrite.empty())
+        {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+        buffersToWrite.clear();
+        output.flush();
+    }
+
+    // stop之后 把前端最后提交的日志写完
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const BufferPtr &buffer : buffers_)
+    {
+        output.append(buffer->data(), buffer->length());
+    }
+    buffers_.clear();
+    output.append(currentBuffer_->data(), currentBuffer_->length());
+    currentBuffer_->reset();
+    output.flush();
+}
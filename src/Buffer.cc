@@ -7,37 +7,148 @@
     };
     */
 #include <unistd.h>
+#include <string.h>
 
 #include "Buffer.h"
+#include "BufferPool.h"
+
+// std::min/std::max按引用传参 静态常量要有定义
+const size_t Buffer::kShrinkThreshold;
+const size_t Buffer::kMaxReadHint;
+
+char *Buffer::emptyStorage()
+{
+    static char storage[kCheapPrepend];
+    return storage;
+}
+
+Buffer::Buffer(Buffer &&other) noexcept
+    : Buffer(other.pool_, other.initalSize_)
+{
+    swap(other);
+}
+
+Buffer &Buffer::operator=(Buffer &&other) noexcept
+{
+    Buffer tmp(std::move(other));
+    swap(tmp);
+    return *this;
+}
+
+void Buffer::swap(Buffer &rhs) noexcept
+{
+    std::swap(buffer_, rhs.buffer_);
+    std::swap(capacity_, rhs.capacity_);
+    std::swap(readerIndex_, rhs.readerIndex_);
+    std::swap(writerIndex_, rhs.writerIndex_);
+    std::swap(initalSize_, rhs.initalSize_);
+    std::swap(readHint_, rhs.readHint_);
+    std::swap(smallReads_, rhs.smallReads_);
+    std::swap(pool_, rhs.pool_);
+}
+
+void Buffer::makeSpace(size_t len)
+{
+    /**
+     * | kCheapPrepend |xxx| reader | writer |                     // xxx标示reader中已读的部分
+     * | kCheapPrepend | reader ｜          len          |
+     **/
+    if (hasStorage() && writableBytes() + prependableBytes() >= len + kCheapPrepend) {
+        //把reader搬到从xxx开始，让xxxwriter连续
+        size_t readable = readableBytes();
+        memmove(begin() + kCheapPrepend, begin() + readerIndex_, readable);
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = readerIndex_ + readable;
+    } else {
+        reallocate(len);
+    }
+}
+
+void Buffer::reallocate(size_t len)
+{
+    size_t readable = readableBytes();
+    size_t need = kCheapPrepend + readable + len;
+    if (!hasStorage()) {
+        need = std::max(need, kCheapPrepend + initalSize_);
+    } else if (len > 0 && pool_ == nullptr) {
+        need = std::max(need, capacity_ * 2); // 没有池子按倍数涨 池子自己按2的幂分档
+    }
+    size_t capacity = 0;
+    char *storage = BufferPool::allocate(pool_, need, &capacity);
+    // 只拷贝可读的部分 不像vector::resize那样先清零再整体拷贝
+    memcpy(storage + kCheapPrepend, peek(), readable);
+    release();
+    buffer_ = storage;
+    capacity_ = capacity;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend + readable;
+}
+
+void Buffer::release()
+{
+    if (hasStorage()) {
+        BufferPool::deallocate(pool_, buffer_, capacity_);
+        buffer_ = emptyStorage();
+        capacity_ = kCheapPrepend;
+    }
+}
+
+// 每个线程一块 读多了才用 不需要清零 一个loop线程同一时刻只会有一个readFd在用
+static __thread char t_readScratch[65536];
 
 ssize_t Buffer::readFd(int fd, int* saveErrno){
-    char extrabuf[65536] = {0};
+    // 按这个连接最近的读取大小预留空间(没有存储时在这里才挂上) 大部分读直接落在缓冲区里 不用再从scratch拷贝
+    ensureWritableBytes(readHint_);
 
     struct iovec vec[2];
     const size_t writable = writableBytes();
 
-    vec[0].iov_base = begin() + writerIndex_;
+    vec[0].iov_base = beginWrite();
     vec[0].iov_len = writable;
 
-    vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof(extrabuf);
+    vec[1].iov_base = t_readScratch;
+    vec[1].iov_len = sizeof(t_readScratch);
 
-    // 如果buffer里剩余空间大于extrabuf的64kb 则不需要使用到extrabuf
-    const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+    // 如果buffer里剩余空间大于scratch的64kb 则不需要使用到scratch
+    const int iovcnt = (writable < sizeof(t_readScratch)) ? 2 : 1;
     const ssize_t n = ::readv(fd, vec, iovcnt);     //readv 是按照给的空间来读的，有多少读多少
 
     if (n < 0) {
         *saveErrno = errno;
-    } else if (n <= writable) {
+    } else if (static_cast<size_t>(n) <= writable) {
         writerIndex_ += n;
     } else {
-        writerIndex_ = buffer_.size();
-        append(extrabuf, n-writable);  //扩容，拷贝进去
+        writerIndex_ = capacity_;
+        append(t_readScratch, n-writable);  //扩容，拷贝进去
+    }
+    if (n > 0) {
+        adjustReadHint(n);
+    }
+
+    if (pool_ && readableBytes() == 0) {
+        release(); // 什么都没读到(EAGAIN/对端关闭) 不占着池子的块
     }
     
     return n;
 }
 
+void Buffer::adjustReadHint(size_t n)
+{
+    if (n >= readHint_) {
+        // 读满了 内核里多半还有 下次多留点
+        readHint_ = std::min(readHint_ * 2, kMaxReadHint);
+        smallReads_ = 0;
+    } else if (n < readHint_ / 2) {
+        // 连续两次都不到一半才缩 避免大小消息交替时来回抖
+        if (++smallReads_ >= 2) {
+            readHint_ = std::max(readHint_ / 2, initalSize_);
+            smallReads_ = 0;
+        }
+    } else {
+        smallReads_ = 0;
+    }
+}
+
 
 ssize_t Buffer::writeFd(int fd, int* saveErrno) {
     ssize_t n = ::write(fd, peek(), readableBytes());
@@ -0,0 +1,187 @@
+#include <stdlib.h>
+
+#include "BufferPool.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+BufferPool::BufferPool(EventLoop *loop, size_t maxCachedBytesPerClass)
+    : loop_(loop)
+    , maxCachedBytesPerClass_(maxCachedBytesPerClass)
+    , oversizedInUse_(0)
+    , oversizedBytesInUse_(0)
+    , allocations_(0)
+    , hits_(0)
+    , oversized_(0)
+    , foreignOversizedInUse_(0)
+    , foreignOversizedBytesInUse_(0)
+{
+    for (int i = 0; i < kNumClasses; ++i)
+    {
+        freeLists_[i] = nullptr;
+        cached_[i] = 0;
+        inUse_[i] = 0;
+        foreignInUse_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+BufferPool::~BufferPool()
+{
+    trim();
+}
+
+int BufferPool::classIndex(size_t size)
+{
+    int index = 0;
+    while (classSize(index) < size)
+    {
+        ++index;
+    }
+    return index;
+}
+
+char *BufferPool::allocate(size_t size, size_t *capacity)
+{
+    if (!loop_->isInLoopThread())
+    {
+        // 空闲链表不加锁 别的线程来借直接malloc
+        // 大小照样取整到档位: 这块可能在loop线程里还回来 那边按capacity归档进空闲链表
+        if (size > kMaxBlockSize)
+        {
+            foreignOversizedInUse_.fetch_add(1, std::memory_order_relaxed);
+            foreignOversizedBytesInUse_.fetch_add(size, std::memory_order_relaxed);
+            *capacity = size;
+            return static_cast<char *>(::malloc(size));
+        }
+        int index = classIndex(size);
+        foreignInUse_[index].fetch_add(1, std::memory_order_relaxed);
+        *capacity = classSize(index);
+        return static_cast<char *>(::malloc(*capacity));
+    }
+
+    ++allocations_;
+    if (size > kMaxBlockSize)
+    {
+        ++oversized_;
+        ++oversizedInUse_;
+        oversizedBytesInUse_ += size;
+        *capacity = size;
+        return static_cast<char *>(::malloc(size));
+    }
+
+    int index = classIndex(size);
+    *capacity = classSize(index);
+    ++inUse_[index];
+    if (freeLists_[index])
+    {
+        ++hits_;
+        --cached_[index];
+        FreeBlock *block = freeLists_[index];
+        freeLists_[index] = block->next;
+        return reinterpret_cast<char *>(block);
+    }
+    return static_cast<char *>(::malloc(*capacity));
+}
+
+void BufferPool::deallocate(char *block, size_t capacity)
+{
+    if (!loop_->isInLoopThread())
+    {
+        if (capacity > kMaxBlockSize)
+        {
+            foreignOversizedInUse_.fetch_sub(1, std::memory_order_relaxed);
+            foreignOversizedBytesInUse_.fetch_sub(capacity, std::memory_order_relaxed);
+        }
+        else
+        {
+            foreignInUse_[classIndex(capacity)].fetch_sub(1, std::memory_order_relaxed);
+        }
+        ::free(block);
+        return;
+    }
+
+    if (capacity > kMaxBlockSize)
+    {
+        --oversizedInUse_;
+        oversizedBytesInUse_ -= capacity;
+        ::free(block);
+        return;
+    }
+
+    int index = classIndex(capacity);
+    --inUse_[index];
+    if ((cached_[index] + 1) * classSize(index) > maxCachedBytesPerClass_)
+    {
+        ::free(block);
+        return;
+    }
+    FreeBlock *free = reinterpret_cast<FreeBlock *>(block);
+    free->next = freeLists_[index];
+    freeLists_[index] = free;
+    ++cached_[index];
+}
+
+void BufferPool::trim()
+{
+    for (int i = 0; i < kNumClasses; ++i)
+    {
+        while (freeLists_[i])
+        {
+            FreeBlock *block = freeLists_[i];
+            freeLists_[i] = block->next;
+            ::free(block);
+        }
+        cached_[i] = 0;
+    }
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    Stats s = {};
+    for (int i = 0; i < kNumClasses; ++i)
+    {
+        int64_t inUse = inUse_[i] + foreignInUse_[i].load(std::memory_order_relaxed);
+        s.classInUse[i] = inUse;
+        s.classCached[i] = cached_[i];
+        s.blocksInUse += inUse;
+        s.bytesInUse += inUse * classSize(i);
+        s.cachedBlocks += cached_[i];
+        s.cachedBytes += cached_[i] * classSize(i);
+    }
+    s.blocksInUse += oversizedInUse_ + foreignOversizedInUse_.load(std::memory_order_relaxed);
+    s.bytesInUse += oversizedBytesInUse_ + foreignOversizedBytesInUse_.load(std::memory_order_relaxed);
+    s.allocations = allocations_;
+    s.hits = hits_;
+    s.oversized = oversized_;
+    return s;
+}
+
+char *BufferPool::allocate(BufferPool *pool, size_t size, size_t *capacity)
+{
+    char *block = nullptr;
+    if (pool)
+    {
+        block = pool->allocate(size, capacity);
+    }
+    else
+    {
+        *capacity = size;
+        block = static_cast<char *>(::malloc(size));
+    }
+    if (block == nullptr)
+    {
+        LOG_FATAL("Buffer malloc %zu bytes failed\n", size);
+    }
+    return block;
+}
+
+void BufferPool::deallocate(BufferPool *pool, char *block, size_t capacity)
+{
+    if (pool)
+    {
+        pool->deallocate(block, capacity);
+    }
+    else
+    {
+        ::free(block);
+    }
+}
@@ -0,0 +1,403 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <algorithm>
+
+#include "ChainBuffer.h"
+#include "BufferPool.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+ChainBuffer::ChainBuffer(BufferPool *pool)
+    : pool_(pool)
+    , readable_(0)
+    , nextZeroCopyId_(0)
+    , zeroCopySends_(0)
+{
+}
+
+ChainBuffer::~ChainBuffer()
+{
+    for (Slab &slab : slabs_)
+    {
+        freeSlab(slab);
+    }
+    freeSlab(spare_);
+    // 没收到完成通知的发送 内核可能还会重传 这时候release了用户的内存就可能被改写后发出去
+    // TcpConnection会等通知取完才析构 走到这里说明等不到了(比如loop已经退出) 宁可泄漏也不release
+    if (!inflight_.empty())
+    {
+        LOG_ERROR("ChainBuffer destroyed with %zu zero-copy sends not completed, leaking their data\n", inflight_.size());
+    }
+}
+
+void ChainBuffer::releaseOwner(ZeroCopyOwner *owner)
+{
+    if (owner->release)
+    {
+        owner->release();
+    }
+    delete owner;
+}
+
+void ChainBuffer::freeSlab(Slab &slab)
+{
+    if (slab.ownedString)
+    {
+        delete slab.ownedString;
+        slab.ownedString = nullptr;
+    }
+    else if (slab.ownedBuffer)
+    {
+        delete slab.ownedBuffer;
+        slab.ownedBuffer = nullptr;
+    }
+    else if (slab.zeroCopy)
+    {
+        // 还有发送没收到完成通知的 等zeroCopyCompleted再释放
+        slab.zeroCopy->consumed = true;
+        if (slab.zeroCopy->pendingSends == 0)
+        {
+            releaseOwner(slab.zeroCopy);
+        }
+        slab.zeroCopy = nullptr;
+    }
+    else if (slab.data)
+    {
+        BufferPool::deallocate(pool_, slab.data, slab.size);
+    }
+    slab.data = nullptr;
+}
+
+ChainBuffer::Slab ChainBuffer::newSlab(size_t size)
+{
+    if (size == kSlabSize && spare_.data)
+    {
+        Slab slab = spare_;
+        spare_ = Slab();
+        return slab;
+    }
+    Slab slab;
+    slab.data = BufferPool::allocate(pool_, size, &slab.size);
+    return slab;
+}
+
+void ChainBuffer::popFront()
+{
+    Slab &front = slabs_.front();
+    if (!pool_ && front.size == kSlabSize && !spare_.data && !front.ownedString && !front.ownedBuffer && !front.zeroCopy && !front.file)
+    {
+        spare_ = Slab(front.data, front.size, 0, 0);
+    }
+    else
+    {
+        freeSlab(front);
+    }
+    slabs_.pop_front();
+}
+
+const char *ChainBuffer::peek(int *saveErrno)
+{
+    if (slabs_.empty())
+    {
+        return nullptr;
+    }
+    if (slabs_.front().readableBytes() < readable_ || slabs_.front().file)
+    {
+        // 跨slab了 或者数据还在文件里(文件slab没有内存) 合并成一个刚好放得下的slab
+        Slab merged = newSlab(readable_);
+        for (const Slab &slab : slabs_)
+        {
+            if (!copyOut(slab, merged.data + merged.writerIndex, slab.readableBytes(), saveErrno))
+            {
+                // 和writeFd一样报错 不拿填零的数据冒充文件内容 链保持原样
+                freeSlab(merged);
+                return nullptr;
+            }
+            merged.writerIndex += slab.readableBytes();
+        }
+        while (!slabs_.empty())
+        {
+            popFront();
+        }
+        slabs_.push_back(std::move(merged));
+    }
+    const Slab &front = slabs_.front();
+    return front.data + front.readerIndex;
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+    if (len >= readable_)
+    {
+        retrieveAll();
+        return;
+    }
+    readable_ -= len;
+    while (len > 0)
+    {
+        Slab &front = slabs_.front();
+        size_t n = std::min(len, front.readableBytes());
+        front.readerIndex += n;
+        len -= n;
+        if (front.readableBytes() == 0)
+        {
+            popFront();
+        }
+    }
+}
+
+void ChainBuffer::retrieveAll()
+{
+    while (!slabs_.empty())
+    {
+        popFront();
+    }
+    readable_ = 0;
+}
+
+std::string ChainBuffer::retrieveAsString(size_t len)
+{
+    len = std::min(len, readable_);
+    std::string result;
+    result.reserve(len);
+    size_t left = len;
+    for (const Slab &slab : slabs_)
+    {
+        if (left == 0)
+        {
+            break;
+        }
+        size_t n = std::min(left, slab.readableBytes());
+        size_t oldSize = result.size();
+        result.resize(oldSize + n);
+        int savedErrno = 0;
+        if (!copyOut(slab, &result[oldSize], n, &savedErrno))
+        {
+            result.resize(oldSize); // 这一段和后面的都不返回 照样从缓冲区里去掉
+            break;
+        }
+        left -= n;
+    }
+    retrieve(len);
+    return result;
+}
+
+void ChainBuffer::append(const char *data, size_t len)
+{
+    readable_ += len;
+    if (!slabs_.empty())
+    {
+        Slab &back = slabs_.back();
+        size_t n = std::min(len, back.writableBytes());
+        memcpy(back.data + back.writerIndex, data, n);
+        back.writerIndex += n;
+        data += n;
+        len -= n;
+    }
+    while (len > 0)
+    {
+        slabs_.push_back(newSlab(kSlabSize));
+        Slab &back = slabs_.back();
+        size_t n = std::min(len, back.size);
+        memcpy(back.data, data, n);
+        back.writerIndex = n;
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::append(std::string &&str, size_t offset)
+{
+    size_t len = str.size() - offset;
+    if (len < kAdoptThreshold)
+    {
+        append(str.data() + offset, len);
+        return;
+    }
+    std::string *owned = new std::string(std::move(str));
+    Slab slab(const_cast<char *>(owned->data()), owned->size(), offset, owned->size());
+    slab.ownedString = owned;
+    slabs_.push_back(slab);
+    readable_ += len;
+}
+
+void ChainBuffer::append(Buffer &&buf)
+{
+    size_t len = buf.readableBytes();
+    if (len < kAdoptThreshold)
+    {
+        append(buf.peek(), len);
+        buf.retrieveAll();
+        return;
+    }
+    Buffer *owned = new Buffer(std::move(buf));
+    Slab slab(const_cast<char *>(owned->peek()), len, 0, len);
+    slab.ownedBuffer = owned;
+    slabs_.push_back(slab);
+    readable_ += len;
+}
+
+void ChainBuffer::appendZeroCopy(const char *data, size_t len, Task<void()> release)
+{
+    ZeroCopyOwner *owner = new ZeroCopyOwner{std::move(release), 0, false};
+    Slab slab(const_cast<char *>(data), len, 0, len);
+    slab.zeroCopy = owner;
+    slabs_.push_back(slab);
+    readable_ += len;
+}
+
+void ChainBuffer::appendFile(int fd, off_t offset, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    Slab slab(nullptr, count, 0, count);
+    slab.file = true;
+    slab.fileFd = fd;
+    slab.fileOffset = offset;
+    slabs_.push_back(slab);
+    readable_ += count;
+}
+
+bool ChainBuffer::copyOut(const Slab &slab, char *dst, size_t n, int *saveErrno)
+{
+    if (!slab.file)
+    {
+        memcpy(dst, slab.data + slab.readerIndex, n);
+        return true;
+    }
+    off_t offset = slab.fileOffset + slab.readerIndex;
+    while (n > 0)
+    {
+        ssize_t r = ::pread(slab.fileFd, dst, n, offset);
+        if (r < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (r <= 0)
+        {
+            // 文件比登记的短(r == 0)和sendFileSlab一样按EIO算
+            int err = (r == 0) ? EIO : errno;
+            LOG_ERROR("ChainBuffer pread fd=%d failed errno=%d\n", slab.fileFd, err);
+            if (saveErrno)
+            {
+                *saveErrno = err;
+            }
+            return false;
+        }
+        dst += r;
+        offset += r;
+        n -= r;
+    }
+    return true;
+}
+
+ssize_t ChainBuffer::sendFileSlab(int fd, int *saveErrno)
+{
+    const Slab &front = slabs_.front();
+    off_t offset = front.fileOffset + front.readerIndex;
+    ssize_t n = ::sendfile(fd, front.fileFd, &offset, front.readableBytes());
+    if (n < 0 && (errno == EINVAL || errno == ENOSYS))
+    {
+        // 这个fd不支持sendfile(比如某些特殊文件系统) 退回pread + write
+        char buf[64 * 1024];
+        ssize_t r = ::pread(front.fileFd, buf, std::min(sizeof buf, front.readableBytes()), offset);
+        if (r == 0)
+        {
+            errno = EIO;
+            r = -1;
+        }
+        n = (r > 0) ? ::write(fd, buf, r) : r;
+    }
+    else if (n == 0)
+    {
+        // 文件比登记的短 剩下的永远发不出去
+        errno = EIO;
+        n = -1;
+    }
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
+
+void ChainBuffer::zeroCopyCompleted(uint32_t lo, uint32_t hi)
+{
+    // 编号是32位回绕的 通知基本按顺序到 一般都在队头
+    for (auto it = inflight_.begin(); it != inflight_.end();)
+    {
+        if (static_cast<uint32_t>(it->id - lo) <= static_cast<uint32_t>(hi - lo))
+        {
+            ZeroCopyOwner *owner = it->owner;
+            it = inflight_.erase(it);
+            if (--owner->pendingSends == 0 && owner->consumed)
+            {
+                releaseOwner(owner);
+            }
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+ssize_t ChainBuffer::sendZeroCopy(int fd, int *saveErrno)
+{
+    Slab &front = slabs_.front();
+    ssize_t n = ::send(fd, front.data + front.readerIndex, front.readableBytes(), MSG_ZEROCOPY);
+    if (n >= 0)
+    {
+        ++front.zeroCopy->pendingSends;
+        inflight_.push_back(InflightSend{nextZeroCopyId_++, front.zeroCopy});
+        ++zeroCopySends_;
+        return n;
+    }
+    if (errno == ENOBUFS)
+    {
+        // 超过了net.core.optmem_max 这次退回普通拷贝发送
+        n = ::send(fd, front.data + front.readerIndex, front.readableBytes(), 0);
+    }
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int *saveErrno)
+{
+    if (!slabs_.empty() && slabs_.front().zeroCopy)
+    {
+        return sendZeroCopy(fd, saveErrno);
+    }
+    if (!slabs_.empty() && slabs_.front().file)
+    {
+        return sendFileSlab(fd, saveErrno);
+    }
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    for (const Slab &slab : slabs_)
+    {
+        if (iovcnt == IOV_MAX || slab.zeroCopy || slab.file)
+        {
+            break; // 零拷贝slab和文件slab单独发
+        }
+        vec[iovcnt].iov_base = slab.data + slab.readerIndex;
+        vec[iovcnt].iov_len = slab.readableBytes();
+        ++iovcnt;
+    }
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
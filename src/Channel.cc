@@ -6,15 +6,17 @@
 const int Channel::kNoneEvent = 0; //空事件 
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kErrorEvent = EPOLLERR;
 
 // EventLoop: ChannelList Poller
 Channel::Channel(EventLoop *loop, int fd)
-    : loop_(loop)
-    , fd_(fd)
+    : fd_(fd)
     , events_(0)
     , revents_(0)
     , index_(-1)
-    , tied_(false) {}
+    , tied_(false)
+    , edgeTriggered_(false)
+    , loop_(loop) {}
 
 Channel::~Channel() {}
 
@@ -45,7 +47,7 @@ void Channel::handleEvent(Timestamp receiveTime) {
 }
 
 void Channel::handleEventWithGuard(Timestamp receiveTime) {
-    LOG_INFO("channel handleEvent revents: %d\n", revents_);
+    LOG_DEBUG("channel handleEvent revents: %d\n", revents_);
     // 关闭-挂起且没有数据可读了，TcpConnection 通过shutdown关闭写端epoll触发EPOLLHUP
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN)) {
         if (closeCallback_) {
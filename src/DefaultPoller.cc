@@ -1,12 +1,38 @@
 #include <stdlib.h>
+#include <string.h>
+#include <atomic>
 
 #include "Poller.h"
 #include "EPollPoller.h"
+#include "IoUringPoller.h"
+#include "Logger.h"
+
+static std::atomic<int> s_defaultBackend(Poller::kEpoll);
+
+void Poller::setDefaultBackend(Backend backend)
+{
+    s_defaultBackend = backend;
+}
 
 Poller* Poller::newDefaultPoller(EventLoop* loop) {
+    int backend = s_defaultBackend;
+    const char *uring = ::getenv("MUDUO_USE_IOURING");
+    if (uring && ::strcmp(uring, "0") != 0) {
+        backend = kIoUring;
+    }
+
     if (::getenv("MUDUO_USE_POLL")) {
         return nullptr; //还未实现，返回poll的实例
+    } else if (backend == kIoUring) {
+        IoUringPoller *poller = new IoUringPoller(loop);
+        if (poller->valid()) {
+            LOG_INFO("EventLoop %p uses io_uring poller\n", loop);
+            return poller;
+        }
+        delete poller;
+        LOG_WARN("io_uring is not supported by this kernel, fall back to epoll\n");
+        return new EPollPoller(loop);
     } else {
         return new EPollPoller(loop);  //epoll
     }
-}
\ No newline at end of file
+}
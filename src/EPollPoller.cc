@@ -25,7 +25,7 @@ EPollPoller::~EPollPoller() {
 }
 
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels) {
-    LOG_DEBUG("func=%s => fd total count:%lu\n", __FUNCTION_, channels_.size());
+    LOG_DEBUG("func=%s => fd total count:%lu\n", __FUNCTION__, numChannels_);
     int numEvents = ::epoll_wait(epollfd_, events_.data(), static_cast<int>(events_.size()), timeoutMs);
     int saveErrno = errno;
     Timestamp now(Timestamp::now()); //一个由当前事件创立的事件戳对象
@@ -54,8 +54,7 @@ void EPollPoller::updateChannel(Channel *channel) {
 
     if (index == kNew || index == kDeleted) {
         if (index == kNew) {
-            int fd = channel->fd();
-            channels_[fd] = channel;    //Poller的一个map, 记录关注的channel
+            addChannelEntry(channel);    //Poller按fd下标的表, 记录关注的channel
         } else { 
             //index == kDeleted 这个channel已经删除了 ==  说明map里有这个记录的就什么也不做 
         }
@@ -80,7 +79,7 @@ void EPollPoller::removeChannel(Channel *channel)
     const int index = channel->index();
     LOG_DEBUG("func=%s => fd=%d events=%d index=%d\n", __FUNCTION__, channel->fd(), channel->events(), index);
 
-    int fd = channel->fd();
+    removeChannelEntry(channel);
     if (index == kAdded) {
         update(EPOLL_CTL_DEL, channel);
     }
@@ -91,7 +90,7 @@ void EPollPoller::removeChannel(Channel *channel)
 void EPollPoller::update(int op, Channel *channel) {
     epoll_event ev{};  //将值全部初始化为0， 等于 ::memset(&ev, 0, sizeof(ev));
     int fd = channel->fd();
-    ev.events = channel->events();
+    ev.events = channel->events() | (channel->isEdgeTriggered() ? static_cast<uint32_t>(EPOLLET) : 0);
     ev.data.fd = fd;
     ev.data.ptr = channel;
 
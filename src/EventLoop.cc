@@ -2,12 +2,15 @@
 #include <unistd.h>   //接口函数， 如getpid(), read()
 #include <fcntl.h>   //fd操作 如 open() 打开文件返回fd
 #include <errno.h>
+#include <algorithm>
 #include <memory>
 
 #include "EventLoop.h"
 #include "Logger.h"
 #include "Channel.h"
 #include "Poller.h"
+#include "TimerQueue.h"
+#include "BufferPool.h"
 
 // 防止一个线程创建多个EventLoop
 __thread EventLoop *t_loopInThisThread = nullptr;
@@ -15,6 +18,11 @@ __thread EventLoop *t_loopInThisThread = nullptr;
 // 定义默认的Poller IO复用接口的超时时间
 const int kPollTimeMs = 10000; // 10000毫秒 = 10秒钟
 
+// 只有loop线程写的计数 别的线程relaxed读 不需要加锁的RMW
+static void increment(std::atomic<int64_t> &counter, int64_t n = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
 int createEventfd() {
     int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
     if (evtfd < 0) { 
@@ -28,9 +36,25 @@ EventLoop::EventLoop()
     : looping_(false)
     , quit_(false)
     , threadId_(CurrentThread::tid())
+    , iteration_(0)
     , poller_(Poller::newDefaultPoller(this))
+    , timerQueue_(new TimerQueue(this))
     , wakeupFd_(createEventfd())                   //创建一个
     , wakeupChannel_(new Channel(this, wakeupFd_)) 
+    , bufferPool_(new BufferPool(this))
+    , activeConnections_(0)
+    , establishedConnections_(0)
+    , bytesTransferred_(0)
+    , busyMicroSeconds_(0)
+    , maxSpinMicroSeconds_(0)
+    , adaptiveSpin_(false)
+    , spinBudgetMicroSeconds_(0)
+    , spinMicroSeconds_(0)
+    , spinHits_(0)
+    , spinMisses_(0)
+    , wakeups_(0)
+    , callingPendingFunctors_(false)
+    , wakeupPending_(false)
 {
     LOG_DEBUG("EventLoop created %p in thread %d\n", this, threadId_);
     if (t_loopInThisThread) {
@@ -44,6 +68,7 @@ EventLoop::EventLoop()
         std::bind(&EventLoop::handleRead, this)    //成员函数时需要加&，给具体的地址
     );
 
+    wakeupChannel_->setEdgeTriggered(true); // handleRead读一次就把eventfd计数清零了
     wakeupChannel_->enableReading(); // 每一个EventLoop都将监听wakeupChannel_的EPOLL读事件了
 }
 
@@ -64,17 +89,87 @@ void EventLoop::loop() {
 
     while (!quit_) {
         activeChannels_.clear();
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_); 
+        if (maxSpinMicroSeconds_ > 0) {
+            pollReturnTime_ = busyPoll();
+        } else {
+            pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_); 
+            increment(wakeups_);
+        }
+        pollReturnMonotonic_ = MonotonicTime::now();
+        ++iteration_;
         for(Channel* channel : activeChannels_) {
             channel->handleEvent(pollReturnTime_);
         }
         doPendingFunctors();
+        doIterationEndFunctors();
+        increment(busyMicroSeconds_, MonotonicTime::now().microSeconds() - pollReturnMonotonic_.microSeconds());
     }
 
     LOG_INFO("EventLoop %p stop looping.\n", this);
     looping_ = false;
 }
 
+void EventLoop::setBusyPoll(int64_t spinMicroSeconds, bool adaptive) {
+    maxSpinMicroSeconds_ = spinMicroSeconds > 0 ? spinMicroSeconds : 0;
+    adaptiveSpin_ = adaptive;
+    spinBudgetMicroSeconds_.store(maxSpinMicroSeconds_, std::memory_order_relaxed);
+}
+
+EventLoop::BusyPollStats EventLoop::busyPollStats() const {
+    BusyPollStats stats;
+    stats.spinMicroSeconds = spinMicroSeconds_.load(std::memory_order_relaxed);
+    stats.spinHits = spinHits_.load(std::memory_order_relaxed);
+    stats.spinMisses = spinMisses_.load(std::memory_order_relaxed);
+    stats.wakeups = wakeups_.load(std::memory_order_relaxed);
+    stats.spinBudgetMicroSeconds = spinBudgetMicroSeconds_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+Timestamp EventLoop::busyPoll() {
+    int64_t budget = spinBudgetMicroSeconds_.load(std::memory_order_relaxed);
+    Timestamp now;
+    if (budget > 0) {
+        // 别的线程queueInLoop写的eventfd也在poller里 自旋时一样能看到
+        int64_t start = MonotonicTime::now().microSeconds();
+        int64_t spun = 0;
+        do {
+            now = poller_->poll(0, &activeChannels_);
+            spun = MonotonicTime::now().microSeconds() - start;
+        } while (activeChannels_.empty() && spun < budget && !quit_);
+        increment(spinMicroSeconds_, spun);
+        if (!activeChannels_.empty() || quit_) {
+            increment(spinHits_);
+            adaptSpinBudget(true, 0);
+            return now;
+        }
+        increment(spinMisses_);
+    }
+
+    // 自旋没等到 阻塞 醒来以后看阻塞了多久来调整下一次的预算
+    int64_t blockStart = MonotonicTime::now().microSeconds();
+    now = poller_->poll(kPollTimeMs, &activeChannels_);
+    increment(wakeups_);
+    adaptSpinBudget(false, MonotonicTime::now().microSeconds() - blockStart);
+    return now;
+}
+
+// 和KVM的halt-polling一个思路
+void EventLoop::adaptSpinBudget(bool hit, int64_t blockedMicroSeconds) {
+    if (!adaptiveSpin_ || hit) {
+        return;
+    }
+    const int64_t kGrowStart = std::min<int64_t>(10, maxSpinMicroSeconds_);
+    int64_t budget = spinBudgetMicroSeconds_.load(std::memory_order_relaxed);
+    if (blockedMicroSeconds <= maxSpinMicroSeconds_) {
+        // 多自旋一会儿就能等到 下次加倍
+        budget = budget < kGrowStart ? kGrowStart : std::min(budget * 2, maxSpinMicroSeconds_);
+    } else {
+        // 空闲了很久 自旋白白烧CPU 下次减半 小到一定程度就不自旋了
+        budget = budget / 2 < kGrowStart ? 0 : budget / 2;
+    }
+    spinBudgetMicroSeconds_.store(budget, std::memory_order_relaxed);
+}
+
 //用wakeup来让epoll__wait 不再阻塞（因为有wakeupChannel有事件发生了），然后就会看到quit_ = true; 停止loop
 void EventLoop::quit()
 {
@@ -95,26 +190,54 @@ void EventLoop::runInLoop(Functor cb)
     }
     else // 在非当前EventLoop线程中执行cb，就需要唤醒EventLoop所在线程执行cb
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 
 // 把cb放进队列里，唤醒loop所在的线程执行cb
 void EventLoop::queueInLoop(Functor cb) {
-    {
-        std::unique_lock<std::mutex> lock(mutex_);    //锁上，离开作用域解锁
-        pendingFunctors_.emplace_back(cb);
-    }
+    pendingFunctors_.push(std::move(cb));
     // 如果你不加 if，直接 wakeup()：
     // 每次 queueInLoop() 都会触发一次 eventfd 写操作；
     // 哪怕你就在 loop 线程里，下一行代码就能执行；
     // 或者没有在执行回调，只是闲着也会唤醒；
     // 这样相当于多做了很多没意义的系统调用，造成浪费。
     if (!isInLoopThread() || callingPendingFunctors_) {     //只要有新的回调进来，就需要唤醒防止延迟
-        wakeup(); 
+        // 合并唤醒: loop处理之前只有第一个把标志从false改成true的线程写eventfd
+        // 必须在push之后检查 和doPendingFunctors里"先清标志再取队列"配对 保证不会漏唤醒
+        if (!wakeupPending_.exchange(true, std::memory_order_seq_cst)) {
+            wakeup();
+        }
     }
 }
 
+void EventLoop::runAtIterationEnd(Functor cb)
+{
+    iterationEndFunctors_.push_back(std::move(cb));
+}
+
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // 读掉wakeupfd，重置它
 void EventLoop::handleRead()
 {
@@ -157,18 +280,32 @@ bool EventLoop::hasChannel(Channel *channel)
 
 void EventLoop::doPendingFunctors()
 {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
+    // 先清标志再取队列: 之后push的任务一定能看到false从而重新唤醒 不会卡在队列里
+    wakeupPending_.store(false, std::memory_order_seq_cst);
 
+    // 只执行进来时已经在队列里的回调 执行过程中新投递的留到下一轮 和原来swap的语义一致
+    pendingFunctors_.consumeAll([](Functor &functor) {
+        functor(); // 执行当前loop需要执行的回调操作
+    });
+
+    callingPendingFunctors_ = false;
+}
+
+void EventLoop::doIterationEndFunctors()
+{
+    if (iterationEndFunctors_.empty())
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_); // 交换的方式减少了锁的临界区范围 提升效率 同时避免了死锁 如果执行functor()在临界区内 且functor()中调用queueInLoop()就会产生死锁
+        return;
     }
-
-    for (const Functor &functor : functors)
+    // 这里queueInLoop的回调(比如writeComplete)要等下一轮 得像doPendingFunctors一样唤醒
+    callingPendingFunctors_ = true;
+    // 执行中追加的也在这一轮执行 先移出来再调 push_back扩容不影响正在执行的
+    for (size_t i = 0; i < iterationEndFunctors_.size(); ++i)
     {
-        functor(); // 执行当前loop需要执行的回调操作
+        Functor functor(std::move(iterationEndFunctors_[i]));
+        functor();
     }
-
+    iterationEndFunctors_.clear();
     callingPendingFunctors_ = false;
-}
\ No newline at end of file
+}
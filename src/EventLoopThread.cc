@@ -1,5 +1,6 @@
 #include "EventLoopThread.h"
 #include "EventLoop.h"
+#include "ThreadPlacement.h"
 
 EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
                                 const std::string &name)
@@ -9,6 +10,8 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
     , mutex_()
     , cond_()
     , callback_(cb)
+    , cpu_(-1)
+    , memoryNode_(-1)
     {};
 
 EventLoopThread::~EventLoopThread() {
@@ -32,6 +35,13 @@ EventLoop* EventLoopThread::startLoop() {
 }
 
 void EventLoopThread::threadFunc() {
+    // EventLoop和之后这个线程分配的缓冲区、定时器等都落在本节点的内存上
+    if (cpu_ >= 0) {
+        ThreadPlacement::pinCurrentThread(cpu_);
+    }
+    if (memoryNode_ >= 0) {
+        ThreadPlacement::preferMemoryNode(memoryNode_);
+    }
     EventLoop loop;
 
     if (callback_) {
@@ -1,21 +1,70 @@
+#include <algorithm>
+
+#include "EventLoop.h"
 #include "EventLoopThread.h"
 #include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "ThreadPlacement.h"
+
+namespace
+{
+const int kVirtualNodesPerLoop = 64;       // 一致性hash每个loop在环上的虚拟节点数
+const int64_t kSampleIntervalUs = 100 * 1000; // 负载速率的采样间隔
+
+// murmur3的fmix32 把相邻的输入打散
+uint32_t mix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+} // namespace
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg)
     : baseLoop_(baseLoop)
     , name_(nameArg)
     , started_(false)
     , numThreads_(0)
-    , next_(0) {}
+    , next_(0)
+    , selection_(kRoundRobin)
+    , randomState_(0x9e3779b97f4a7c15ULL)
+    , numaNode_(-1)
+    , baseLoopCpu_(-1) {}
 
 EventLoopThreadPool::~EventLoopThreadPool() {}
 
-void EventLoopThreadPool::start(const ThreadInitCallback &cb = ThreadInitCallback()) {
+void EventLoopThreadPool::start(const ThreadInitCallback &cb) {
     started_ = true;
+
+    if (baseLoopCpu_ >= 0) {
+        int cpu = baseLoopCpu_;
+        baseLoop_->runInLoop([cpu]() {
+            ThreadPlacement::pinCurrentThread(cpu);
+            ThreadPlacement::preferMemoryNode(ThreadPlacement::cpuNode(cpu));
+        });
+    }
+    std::vector<int> cpus(loopCpus_);
+    if (cpus.empty() && numaNode_ >= 0) {
+        cpus = ThreadPlacement::nodeCpus(numaNode_);
+        std::vector<int>::iterator it = std::find(cpus.begin(), cpus.end(), baseLoopCpu_);
+        if (it != cpus.end() && cpus.size() > 1) {
+            cpus.erase(it);
+        }
+    }
+
     for (int i=0; i<numThreads_; ++i) {
         char buf[name_.size() + 32];
         snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
         EventLoopThread *t = new EventLoopThread(cb, buf);
+        if (!cpus.empty()) {
+            int cpu = cpus[i % cpus.size()];
+            t->setPlacement(cpu, numaNode_ >= 0 ? numaNode_ : ThreadPlacement::cpuNode(cpu));
+        } else if (numaNode_ >= 0) {
+            t->setPlacement(-1, numaNode_);
+        }
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop());
     }
@@ -23,6 +72,10 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb = ThreadInitCallbac
     if (numThreads_ == 0 && cb) {
         cb(baseLoop_);
     }
+
+    loads_.assign(loops_.size(), LoopLoad{0, 0, 0, 0, 0});
+    lastSample_ = MonotonicTime::now();
+    buildHashRing();
 }
 
 EventLoop *EventLoopThreadPool::getNextLoop() {
@@ -39,6 +92,138 @@ EventLoop *EventLoopThreadPool::getNextLoop() {
     return loop;
 }
 
+EventLoop *EventLoopThreadPool::getLoopForConnection(const InetAddress &peerAddr) {
+    if (loops_.empty()) {
+        return baseLoop_;
+    }
+
+    EventLoop *loop = nullptr;
+    if (selector_) {
+        loop = selector_(loops_, peerAddr);
+    } else {
+        switch (selection_) {
+        case kLeastConnections:
+            loop = leastConnectionsLoop();
+            break;
+        case kPowerOfTwoChoices:
+            loop = powerOfTwoChoicesLoop();
+            break;
+        case kConsistentHash:
+            loop = consistentHashLoop(peerAddr);
+            break;
+        default:
+            loop = getNextLoop();
+            break;
+        }
+    }
+
+    // 记下分出去的连接 loop线程还没来得及connectEstablished的这段时间里也算它的负载
+    std::vector<EventLoop *>::iterator it = std::find(loops_.begin(), loops_.end(), loop);
+    if (it != loops_.end()) {
+        ++loads_[it - loops_.begin()].assigned;
+    }
+    return loop;
+}
+
+int64_t EventLoopThreadPool::pendingConnections(size_t index) const {
+    // 每个loop自己accept的连接不经过这里 established可能比assigned大
+    return std::max<int64_t>(0, loads_[index].assigned - loops_[index]->establishedConnections());
+}
+
+EventLoop *EventLoopThreadPool::leastConnectionsLoop() {
+    // 从轮询位置开始找 连接数一样时不会总落在第一个loop上
+    size_t n = loops_.size();
+    size_t start = next_;
+    next_ = (next_ + 1) % n;
+    size_t best = start;
+    int64_t bestCount = INT64_MAX;
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = (start + k) % n;
+        int64_t count = loops_[i]->activeConnections() + pendingConnections(i);
+        if (count < bestCount) {
+            best = i;
+            bestCount = count;
+        }
+    }
+    return loops_[best];
+}
+
+void EventLoopThreadPool::sampleLoads() {
+    MonotonicTime now(MonotonicTime::now());
+    int64_t elapsedUs = now.microSeconds() - lastSample_.microSeconds();
+    if (elapsedUs < kSampleIntervalUs) {
+        return;
+    }
+    lastSample_ = now;
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        LoopLoad &load = loads_[i];
+        int64_t bytes = loops_[i]->bytesTransferred();
+        int64_t busy = loops_[i]->busyMicroSeconds();
+        load.bytesPerSecond = (bytes - load.lastBytes) * 1e6 / elapsedUs;
+        load.busyFraction = std::min(1.0, static_cast<double>(busy - load.lastBusyMicroSeconds) / elapsedUs);
+        load.lastBytes = bytes;
+        load.lastBusyMicroSeconds = busy;
+    }
+}
+
+double EventLoopThreadPool::loadScore(size_t index, double totalConnections, double totalBytesPerSecond) const {
+    // 三项都归一化到0~1再相加
+    const LoopLoad &load = loads_[index];
+    double connections = static_cast<double>(loops_[index]->activeConnections() + pendingConnections(index));
+    double score = load.busyFraction;
+    if (totalConnections > 0) {
+        score += connections / totalConnections;
+    }
+    if (totalBytesPerSecond > 0) {
+        score += load.bytesPerSecond / totalBytesPerSecond;
+    }
+    return score;
+}
+
+EventLoop *EventLoopThreadPool::powerOfTwoChoicesLoop() {
+    size_t n = loops_.size();
+    if (n == 1) {
+        return loops_[0];
+    }
+    sampleLoads();
+
+    randomState_ ^= randomState_ << 13;
+    randomState_ ^= randomState_ >> 7;
+    randomState_ ^= randomState_ << 17;
+    size_t a = randomState_ % n;
+    size_t b = (a + 1 + (randomState_ >> 32) % (n - 1)) % n; // 和a不同
+
+    double totalConnections = 0;
+    double totalBytesPerSecond = 0;
+    for (size_t i = 0; i < n; ++i) {
+        totalConnections += loops_[i]->activeConnections() + pendingConnections(i);
+        totalBytesPerSecond += loads_[i].bytesPerSecond;
+    }
+    return loadScore(a, totalConnections, totalBytesPerSecond) <= loadScore(b, totalConnections, totalBytesPerSecond)
+               ? loops_[a] : loops_[b];
+}
+
+void EventLoopThreadPool::buildHashRing() {
+    hashRing_.clear();
+    hashRing_.reserve(loops_.size() * kVirtualNodesPerLoop);
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        for (int v = 0; v < kVirtualNodesPerLoop; ++v) {
+            hashRing_.push_back(std::make_pair(mix32(static_cast<uint32_t>(i * kVirtualNodesPerLoop + v) ^ 0x5bd1e995), i));
+        }
+    }
+    std::sort(hashRing_.begin(), hashRing_.end());
+}
+
+EventLoop *EventLoopThreadPool::consistentHashLoop(const InetAddress &peerAddr) {
+    // 只看IP不看端口 同一个客户端的所有连接去同一个loop
+    uint32_t h = mix32(peerAddr.getSockAddr()->sin_addr.s_addr);
+    std::vector<std::pair<uint32_t, size_t>>::const_iterator it =
+        std::lower_bound(hashRing_.begin(), hashRing_.end(), std::make_pair(h, static_cast<size_t>(0)));
+    if (it == hashRing_.end()) {
+        it = hashRing_.begin();
+    }
+    return loops_[it->second];
+}
 
 std::vector<EventLoop *> EventLoopThreadPool::getAllLoops() {
     if (loops_.empty()) {
@@ -0,0 +1,376 @@
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+
+#include "IoUringPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+namespace
+{
+    const int kNew = -1;    // 某个channel还没添加至Poller
+    const int kAdded = 1;   // 某个channel已经添加至Poller
+    const int kDeleted = 2; // 某个channel已经从Poller删除
+
+    // POLL_REMOVE自己的完成事件用这个user_data 收到直接忽略
+    const uint64_t kRemoveUserData = ~0ULL;
+    // io_uring的poll只认这些位 EPOLLET等epoll专有的标志要去掉
+    const uint32_t kPollMask = EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLRDHUP | EPOLLERR | EPOLLHUP;
+
+    int ioUringSetup(unsigned entries, io_uring_params *params)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+    }
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop)
+    , multishot_(false)
+    , ringFd_(-1)
+    , sqRingPtr_(MAP_FAILED)
+    , sqRingSize_(0)
+    , sqHead_(nullptr)
+    , sqTail_(nullptr)
+    , sqRingMask_(nullptr)
+    , sqArray_(nullptr)
+    , sqes_(static_cast<io_uring_sqe *>(MAP_FAILED))
+    , sqesSize_(0)
+    , sqEntries_(0)
+    , toSubmit_(0)
+    , cqRingPtr_(MAP_FAILED)
+    , cqRingSize_(0)
+    , cqHead_(nullptr)
+    , cqTail_(nullptr)
+    , cqRingMask_(nullptr)
+    , cqes_(nullptr)
+    , nextGeneration_(1)
+    , batch_(0)
+{
+    if (!setupRing())
+    {
+        closeRing(); // valid()返回false 由调用者退回epoll
+    }
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    closeRing();
+}
+
+void IoUringPoller::closeRing()
+{
+    if (sqes_ != MAP_FAILED)
+    {
+        ::munmap(sqes_, sqesSize_);
+        sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+    }
+    if (cqRingPtr_ != MAP_FAILED && cqRingPtr_ != sqRingPtr_)
+    {
+        ::munmap(cqRingPtr_, cqRingSize_);
+    }
+    cqRingPtr_ = MAP_FAILED;
+    if (sqRingPtr_ != MAP_FAILED)
+    {
+        ::munmap(sqRingPtr_, sqRingSize_);
+        sqRingPtr_ = MAP_FAILED;
+    }
+    if (ringFd_ >= 0)
+    {
+        ::close(ringFd_);
+        ringFd_ = -1;
+    }
+}
+
+bool IoUringPoller::setupRing()
+{
+    io_uring_params params;
+    ::memset(&params, 0, sizeof params);
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = kRingEntries * 4; // CQ比SQ大 multishot时一个SQE会产生多个CQE
+
+    ringFd_ = ioUringSetup(kRingEntries, &params);
+    if (ringFd_ < 0)
+    {
+        LOG_WARN("io_uring_setup error:%d\n", errno);
+        return false;
+    }
+    // 需要EXT_ARG(5.11)来给io_uring_enter传超时, NODROP保证CQ满时事件不丢
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+    {
+        LOG_WARN("io_uring features 0x%x lack EXT_ARG/NODROP\n", params.features);
+        return false;
+    }
+
+    // multishot poll没有单独的feature位 和RSRC_TAGS同在5.13引入
+    multishot_ = params.features & IORING_FEAT_RSRC_TAGS;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRingPtr_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd_, IORING_OFF_SQ_RING);
+    if (sqRingPtr_ == MAP_FAILED)
+    {
+        LOG_ERROR("mmap sq ring error:%d\n", errno);
+        return false;
+    }
+    if (singleMmap)
+    {
+        cqRingPtr_ = sqRingPtr_;
+    }
+    else
+    {
+        cqRingPtr_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ringFd_, IORING_OFF_CQ_RING);
+        if (cqRingPtr_ == MAP_FAILED)
+        {
+            LOG_ERROR("mmap cq ring error:%d\n", errno);
+            return false;
+        }
+    }
+
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED)
+    {
+        LOG_ERROR("mmap sqes error:%d\n", errno);
+        return false;
+    }
+
+    char *sq = static_cast<char *>(sqRingPtr_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqRingMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqEntries_ = params.sq_entries;
+
+    char *cq = static_cast<char *>(cqRingPtr_);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqRingMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+// 取一个空的SQE 没有SQPOLL线程 内核只在io_uring_enter里读SQ 所以先推进tail再填内容也没问题
+io_uring_sqe *IoUringPoller::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    unsigned tail = *sqTail_;
+    if (tail - head >= sqEntries_)
+    {
+        submit(0, 0); // SQ满了 先提交一批
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (tail - head >= sqEntries_)
+        {
+            LOG_FATAL("io_uring submission queue overflow\n");
+        }
+    }
+    unsigned index = tail & *sqRingMask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    ::memset(sqe, 0, sizeof *sqe);
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    ++toSubmit_;
+    return sqe;
+}
+
+// 提交攒下的SQE waitNr>0时顺便等待CQE 最多等timeoutMs毫秒
+int IoUringPoller::submit(unsigned waitNr, int timeoutMs)
+{
+    unsigned flags = 0;
+    __kernel_timespec ts;
+    io_uring_getevents_arg arg;
+    ::memset(&arg, 0, sizeof arg);
+    if (waitNr > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        arg.sigmask_sz = _NSIG / 8;
+        if (timeoutMs >= 0)
+        {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000 * 1000;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+    }
+
+    int ret = ioUringEnter(ringFd_, toSubmit_, waitNr, flags,
+                           waitNr > 0 ? &arg : nullptr, waitNr > 0 ? sizeof arg : 0);
+    int saveErrno = errno;
+    // 内核消费了多少SQE以head为准 出错时也可能已经提交了一部分
+    toSubmit_ = *sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    errno = saveErrno;
+    return ret;
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    LOG_DEBUG("func=%s => fd total count:%lu\n", __FUNCTION__, numChannels_);
+
+    // 上一轮触发过的单次poll 在这里重新挂上 和这次等待合并成一次系统调用
+    for (int fd : rearmFds_)
+    {
+        auto it = registrations_.find(fd);
+        if (it != registrations_.end() && !it->second.armed && !it->second.channel->isNoneEvent())
+        {
+            arm(fd, it->second);
+        }
+    }
+    rearmFds_.clear();
+
+    int ret = submit(1, timeoutMs);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+
+    if (ret < 0 && saveErrno != ETIME && saveErrno != EINTR && saveErrno != EAGAIN && saveErrno != EBUSY)
+    {
+        errno = saveErrno;
+        LOG_ERROR("IoUringPoller::poll() error:%d!\n", errno);
+    }
+    fillActiveChannels(activeChannels);
+    return now;
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList *activeChannels)
+{
+    ++batch_;
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const io_uring_cqe &cqe = cqes_[head & *cqRingMask_];
+        if (cqe.user_data == kRemoveUserData)
+        {
+            continue;
+        }
+
+        int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+        auto it = registrations_.find(fd);
+        if (it == registrations_.end() || it->second.generation != generation)
+        {
+            continue; // 已经删除或者重新注册过的旧事件
+        }
+
+        Registration &reg = it->second;
+        if (!(cqe.flags & IORING_CQE_F_MORE))
+        {
+            // 单次poll 或者multishot被内核终止了 下一轮重新挂
+            reg.armed = false;
+            rearmFds_.push_back(fd);
+        }
+        if (cqe.res == -ECANCELED)
+        {
+            continue;
+        }
+
+        int revents = cqe.res < 0 ? static_cast<int>(EPOLLERR) : cqe.res;
+        Channel *channel = reg.channel;
+        if (reg.batch == batch_)
+        {
+            channel->set_revents(channel->revents() | revents);
+        }
+        else
+        {
+            reg.batch = batch_;
+            channel->set_revents(revents);
+            activeChannels->push_back(channel);
+        }
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    const int index = channel->index();
+    const int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d events=%d index=%d\n", __FUNCTION__, fd, channel->events(), index);
+
+    if (index == kNew || index == kDeleted)
+    {
+        if (index == kNew)
+        {
+            addChannelEntry(channel);
+        }
+        channel->set_index(kAdded);
+        Registration &reg = registrations_[fd];
+        reg.channel = channel;
+        reg.armed = false;
+        reg.batch = 0;
+        if (!channel->isNoneEvent())
+        {
+            arm(fd, reg);
+        }
+    }
+    else
+    {
+        // 关心的事件变了: 撤掉旧的poll 按新的事件重新挂
+        Registration &reg = registrations_[fd];
+        disarm(fd, reg);
+        if (channel->isNoneEvent())
+        {
+            channel->set_index(kDeleted);
+        }
+        else
+        {
+            arm(fd, reg);
+        }
+    }
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    const int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d events=%d index=%d\n", __FUNCTION__, fd, channel->events(), channel->index());
+
+    removeChannelEntry(channel);
+    auto it = registrations_.find(fd);
+    if (it != registrations_.end())
+    {
+        disarm(fd, it->second);
+        registrations_.erase(it);
+    }
+    channel->set_index(kNew);
+}
+
+void IoUringPoller::arm(int fd, Registration &reg)
+{
+    reg.generation = nextGeneration_++;
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = static_cast<uint32_t>(reg.channel->events()) & kPollMask;
+    sqe->len = (multishot_ && reg.channel->isEdgeTriggered()) ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = userData(fd, reg.generation);
+    reg.armed = true;
+}
+
+void IoUringPoller::disarm(int fd, Registration &reg)
+{
+    if (reg.armed)
+    {
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = userData(fd, reg.generation);
+        sqe->user_data = kRemoveUserData;
+        reg.armed = false;
+    }
+    // 换代 撤销前已经产生的CQE会因为generation对不上被丢掉
+    reg.generation = nextGeneration_++;
+}
@@ -1,8 +1,38 @@
-#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include "Logger.h"
 #include "Timestamp.h"
 
+namespace
+{
+    // 每个线程自己的行缓冲 格式化一行不需要分配内存也不需要加锁
+    const int kMaxLogLine = 4096;
+    __thread char t_logline[kMaxLogLine];
+    // 同一秒内的日志复用格式化好的时间 不必每行都调localtime_r
+    __thread time_t t_lastSecond = 0;
+    __thread char t_time[32];
+
+    void defaultOutput(const char *msg, size_t len)
+    {
+        ::fwrite(msg, 1, len, stdout);
+    }
+
+    void defaultFlush()
+    {
+        ::fflush(stdout);
+    }
+}
+
+std::atomic<int> Logger::s_logLevel_(INFO);
+
+Logger::Logger()
+    : output_(defaultOutput)
+    , flush_(defaultFlush)
+{
+}
+
 // 获取日志唯一的实例对象 单例
 Logger &Logger::instance()
 {
@@ -10,17 +40,11 @@ Logger &Logger::instance()
     return logger;
 }
 
-// 设置日志级别
-void Logger::setLogLevel(int level)
-{
-    logLevel_ = level;
-}
-
 // 写日志 [级别信息] time : msg
-void Logger::log(std::string msg)
+void Logger::log(int level, const char *msg)
 {
-    std::string pre = "";
-    switch (logLevel_)
+    const char *pre = "";
+    switch (level)
     {
     case INFO:
         pre = "[INFO]";
@@ -41,6 +65,28 @@ void Logger::log(std::string msg)
         break;
     }
 
-    // 打印时间和msg
-    std::cout << pre + Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+    time_t seconds = Timestamp::now().secondsSinceEpoch();
+    if (seconds != t_lastSecond)
+    {
+        t_lastSecond = seconds;
+        struct tm tm_time;
+        ::localtime_r(&seconds, &tm_time);
+        ::strftime(t_time, sizeof t_time, "%Y/%m/%d %H:%M:%S", &tm_time);
+    }
+
+    // 打印时间和msg 格式串里通常自带换行 没有的话补一个
+    size_t msgLen = ::strlen(msg);
+    const char *eol = (msgLen > 0 && msg[msgLen - 1] == '\n') ? "" : "\n";
+    int len = snprintf(t_logline, sizeof t_logline, "%s%s : %s%s", pre, t_time, msg, eol);
+    if (len >= kMaxLogLine)
+    {
+        len = kMaxLogLine - 1;
+        t_logline[len - 1] = '\n';
+    }
+    output_(t_logline, static_cast<size_t>(len));
+
+    if (level == FATAL)
+    {
+        flush_(); // 马上要exit 先把缓冲的日志刷出去
+    }
+}
@@ -1,9 +1,11 @@
 #include <unistd.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <string.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <linux/filter.h>
 
 #include "Socket.h"
 #include "Logger.h"
@@ -20,7 +22,8 @@ void Socket::bindAddress(const InetAddress &localaddr) {
 }
 
 void Socket::listen() {
-    if (0 != ::listen(sockfd_, 1024)) {
+    // 内核会截到net.core.somaxconn 短连接洪峰时全连接队列满了SYN会被丢 客户端要等1秒重传
+    if (0 != ::listen(sockfd_, SOMAXCONN)) {
         LOG_FATAL("listen sockfd:%d fail\n", sockfd_);
     }
 }
@@ -44,6 +47,21 @@ void Socket::shutdownWrite()
     }
 }
 
+void Socket::abortConnection()
+{
+    // SO_LINGER {1, 0}: 之后close也是直接RST 不会再把发送队列里的数据慢慢发完
+    struct linger lingerOpt = {1, 0};
+    ::setsockopt(sockfd_, SOL_SOCKET, SO_LINGER, &lingerOpt, sizeof lingerOpt);
+    // connect(AF_UNSPEC)让内核断开连接: 发RST 清空发送队列 fd还留着 错误队列照样能读
+    struct sockaddr addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sa_family = AF_UNSPEC;
+    if (::connect(sockfd_, &addr, sizeof addr) < 0)
+    {
+        LOG_WARN("Socket::abortConnection fd=%d errno=%d\n", sockfd_, errno);
+    }
+}
+
 void Socket::setTcpNoDelay(bool on)
 {
     // TCP_NODELAY 用于禁用 Nagle 算法。
@@ -76,4 +94,77 @@ void Socket::setKeepAlive(bool on)
     // 这对于检测网络中失效的对等方非常有用。
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
-}
\ No newline at end of file
+}
+
+bool Socket::setDeferAccept(int seconds)
+{
+    // TCP_DEFER_ACCEPT 握手完成后先不放进全连接队列 等客户端的第一段数据到了再唤醒accept
+    // 请求/响应协议里accept之后马上就能读 省一轮epoll 超时后内核照样交给accept
+    int optval = seconds;
+    if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &optval, sizeof(optval)) < 0)
+    {
+        LOG_WARN("Socket::setDeferAccept fd=%d errno=%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setFastOpen(int queueLength)
+{
+    // TCP_FASTOPEN 客户端带着cookie时数据跟SYN一起到 握手还没完成就能accept和读 省一个RTT
+    // 还要net.ipv4.tcp_fastopen打开服务端那一位(0x2) 否则设置成功也不生效
+    int optval = queueLength;
+    if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, &optval, sizeof(optval)) < 0)
+    {
+        LOG_WARN("Socket::setFastOpen fd=%d errno=%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setBusyPoll(int usec, bool prefer)
+{
+    // 收包走网卡NAPI轮询而不是等中断 同一个NAPI上的socket用epoll_wait时epoll也会忙轮询
+    // SO_PREFER_BUSY_POLL(5.11+) 让忙轮询的时候软中断让路 回环设备没有NAPI 设了也不起作用
+    int optval = usec;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &optval, sizeof(optval)) < 0)
+    {
+        LOG_WARN("Socket::setBusyPoll fd=%d errno=%d\n", sockfd_, errno);
+        return false;
+    }
+#ifdef SO_PREFER_BUSY_POLL
+    optval = prefer ? 1 : 0;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_PREFER_BUSY_POLL, &optval, sizeof(optval)) < 0)
+    {
+        LOG_WARN("Socket::setBusyPoll prefer fd=%d errno=%d\n", sockfd_, errno);
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+    // SO_ZEROCOPY 允许send带MSG_ZEROCOPY 发送时直接引用用户页面不拷贝 内核用完后从错误队列通知
+    // 需要4.14以上的内核
+    int optval = on ? 1 : 0;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval)) < 0)
+    {
+        LOG_WARN("Socket::setZeroCopy fd=%d errno=%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::attachReusePortCbpf(const struct sock_filter *code, unsigned short len)
+{
+    struct sock_fprog prog;
+    prog.len = len;
+    prog.filter = const_cast<struct sock_filter *>(code);
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) < 0)
+    {
+        LOG_ERROR("attach reuseport cbpf sockfd:%d fail errno:%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
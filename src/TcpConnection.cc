@@ -5,7 +5,12 @@
 #include <sys/socket.h>
 #include <string.h>
 #include <netinet/tcp.h>
-#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <limits.h>
+#include <stdint.h>
+#include <vector>
 #include <fcntl.h> // for open
 #include <unistd.h> // for close
 
@@ -15,6 +20,13 @@
 #include "Channel.h"
 #include "EventLoop.h"
 
+// 连接销毁时还有零拷贝发送没收到完成通知 隔多久去错误队列取一次
+static const double kZeroCopyDrainInterval = 0.01;
+// 最多等多久 对端一直不读的话通知永远不会来 到时间就RST掉连接让内核清空发送队列
+static const double kZeroCopyDrainTimeout = 5.0;
+// RST之后再等多久 发送队列里的skb放掉之后通知才会到
+static const double kZeroCopyAbortGrace = 0.5;
+
 static EventLoop *CheckLoopNotNull(EventLoop *loop) {
     if (loop == nullptr) {
         LOG_FATAL("%s:%s:%d mainLoop is null!\n", __FILE__, __FUNCTION__, __LINE__);
@@ -23,19 +35,37 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop) {
 }
 
 TcpConnection::TcpConnection(EventLoop *loop,
-                            const std::string &nameArg,
+                            uint64_t id,
+                            std::shared_ptr<const std::string> namePrefix,
                             int sockfd,
                             const InetAddress &localAddr,
                             const InetAddress &peerAddr) 
     : loop_(CheckLoopNotNull(loop))
-    , name_(nameArg)
+    , id_(id)
+    , namePrefix_(std::move(namePrefix))
     , state_(kConnecting)
     , reading_(true)
+    , inputPaused_(false)
+    , edgeTriggered_(false)
+    , readBudget_(0)
+    , zeroCopy_(false)
+    , zeroCopyThreshold_(kDefaultZeroCopyThreshold)
+    , zeroCopyCompletions_(0)
+    , zeroCopyCopied_(0)
+    , autoCork_(false)
+    , corkFlushPending_(false)
+    , readOnEstablish_(false)
     , socket_(std::make_unique<Socket>(sockfd))
     , channel_(std::make_unique<Channel>(loop, sockfd))
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64 * 1024 * 1024)
+    , lowWaterMark_(0)
+    , inputHighWaterMark_(SIZE_MAX)
+    , inputLowWaterMark_(0)
+    , idleWheel_(nullptr)
+    , inputBuffer_(loop->bufferPool())   // 只记下池子 第一次读写时才分配
+    , outputBuffer_(loop->bufferPool())
 {
     channel_->setReadCallback(
         std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
@@ -46,61 +76,402 @@ TcpConnection::TcpConnection(EventLoop *loop,
     channel_->setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
     
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
+    // 直接用共享的前缀和id打 不调name() 否则每个连接都要拼一次名字
+    LOG_INFO("TcpConnection::ctor[%s#%llu] at fd=%d\n", namePrefix_->c_str(), static_cast<unsigned long long>(id_), sockfd);
     socket_->setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d\n", name_.c_str(), channel_->fd(), (int)state_);
+    LOG_INFO("TcpConnection::dtor[%s#%llu] at fd=%d state=%d\n", namePrefix_->c_str(), static_cast<unsigned long long>(id_),
+             channel_->fd(), (int)state_);
+}
+
+const std::string &TcpConnection::name() const {
+    std::call_once(nameOnce_, [this]() {
+        char buf[32];
+        snprintf(buf, sizeof buf, "#%llu", static_cast<unsigned long long>(id_));
+        name_ = *namePrefix_ + buf;
+    });
+    return name_;
+}
+
+void TcpConnection::send(const void *data, size_t len) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(data, len);
+        } else {
+            // 调用方的内存等不到loop线程执行 必须拷贝一份带过去
+            std::string message(static_cast<const char *>(data), len);
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), std::move(message)));
+        }
+    }
+}
+
+void TcpConnection::send(const StringPiece &message) {
+    send(message.data(), message.size());
+}
+
+void TcpConnection::send(std::string &&message) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendStringInLoop(message);
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), std::move(message)));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer &&buf) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendBufferInLoop(buf);
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendBufferInLoop, shared_from_this(), std::move(buf)));
+        }
+    }
 }
 
-void TcpConnection::send(const std::string& buf) {
+void TcpConnection::sendZeroCopy(const void *data, size_t len, ReleaseCallback release) {
     if (state_ == kConnected) {
         if (loop_->isInLoopThread()) {
-            sendInLoop(buf.c_str(), buf.size());
+            sendZeroCopyInLoop(data, len, release);
         } else {
-            loop_->runInLoop(std::bind(&TcpConnection::sendInLoop, this, buf.c_str(), buf.size()));
+            loop_->runInLoop(std::bind(&TcpConnection::sendZeroCopyInLoop, shared_from_this(), data, len, std::move(release)));
+        }
+    } else if (release) {
+        release();
+    }
+}
+
+void TcpConnection::setZeroCopy(bool on, size_t threshold) {
+    zeroCopy_ = on && socket_->setZeroCopy(true);
+    zeroCopyThreshold_ = threshold;
+    if (zeroCopy_ && state_ == kConnected) {
+        channel_->enableErrorEvents();
+    }
+}
+
+TcpConnection::ZeroCopyStats TcpConnection::zeroCopyStats() const {
+    return ZeroCopyStats{outputBuffer_.zeroCopySends(), zeroCopyCompletions_, zeroCopyCopied_, outputBuffer_.zeroCopyInflight()};
+}
+
+void TcpConnection::send(const StringPiece *fragments, size_t count) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendFragmentsInLoop(fragments, count);
+        } else {
+            // 跨线程只能拷贝 顺便拼成一块
+            size_t total = 0;
+            for (size_t i = 0; i < count; ++i) {
+                total += fragments[i].size();
+            }
+            std::string message;
+            message.reserve(total);
+            for (size_t i = 0; i < count; ++i) {
+                message.append(fragments[i].data(), fragments[i].size());
+            }
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), std::move(message)));
+        }
+    }
+}
+
+bool TcpConnection::writingBlocked() const {
+    // LT模式下有数据排队时一定注册着EPOLLOUT; ET模式EPOLLOUT一直注册着 只能看缓冲区
+    return outputBuffer_.readableBytes() > 0 || (!edgeTriggered_ && channel_->isWriting());
+}
+
+size_t TcpConnection::sendDirectly(const struct iovec *vec, int iovcnt, size_t total, bool *faultError) {
+    if (writingBlocked() || autoCork_) {
+        return 0; // auto-cork时全部进缓冲区 本轮末尾一起写
+    }
+    ssize_t nwrote = (iovcnt == 1) ? ::write(channel_->fd(), vec[0].iov_base, vec[0].iov_len)
+                                   : ::writev(channel_->fd(), vec, iovcnt);
+    if (nwrote >= 0) {
+        loop_->addTransferred(nwrote);
+        if (static_cast<size_t>(nwrote) == total) {
+            queueWriteComplete();
+        }
+        return nwrote;
+    }
+    if (errno != EWOULDBLOCK) {
+        LOG_ERROR("TcpConnction::sendInLoop");
+        if (errno == EPIPE || errno == ECONNRESET) {
+            *faultError = true;
+        }
+    }
+    return 0;
+}
+
+void TcpConnection::queueWriteComplete() {
+    if (writeCompleteCallback_) {
+        loop_->queueInLoop(std::bind(&TcpConnection::writeCompleteInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::outputRetrieved(size_t oldLen) {
+    size_t newLen = outputBuffer_.readableBytes();
+    if (newLen <= lowWaterMark_ && oldLen > lowWaterMark_ && lowWaterMarkCallback_) {
+        loop_->queueInLoop(std::bind(lowWaterMarkCallback_, shared_from_this(), newLen));
+    }
+}
+
+void TcpConnection::writeCompleteInLoop() {
+    // 排队期间同一轮回调里可能又send/sendFile了 那就等这些也发完再回调
+    if (outputBuffer_.readableBytes() == 0 && writeCompleteCallback_) {
+        writeCompleteCallback_(shared_from_this());
+    }
+}
+
+void TcpConnection::outputQueued(size_t oldLen) {
+    size_t newLen = outputBuffer_.readableBytes();
+    if (newLen >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+    }
+    if (autoCork_ && (oldLen == 0 || corkFlushPending_)) {
+        // 缓冲区原来是空的 说明没在等EPOLLOUT 登记本轮末尾flush
+        if (!corkFlushPending_) {
+            corkFlushPending_ = true;
+            loop_->runAtIterationEnd(std::bind(&TcpConnection::flushCorked, shared_from_this()));
         }
+        return;
+    }
+    if (!channel_->isWriting()) {
+        channel_->enableWriting();
     }
 }
 
 void TcpConnection::sendInLoop(const void* data, size_t len) {
-    ssize_t nwrote = 0;
-    size_t remaining = len;
+    if (state_ == kDisconnected) {
+        LOG_ERROR("disconnected, give up writing");
+        return;
+    }
+    bool faultError = false;
+    struct iovec vec = {const_cast<void *>(data), len};
+    size_t nwrote = sendDirectly(&vec, 1, len, &faultError);
+
+    //没send完
+    if (!faultError && nwrote < len) {
+        size_t oldLen = outputBuffer_.readableBytes();
+        outputBuffer_.append(static_cast<const char*>(data) + nwrote, len - nwrote);
+        outputQueued(oldLen);
+    }
+}
+
+void TcpConnection::sendStringInLoop(std::string &message) {
+    if (state_ == kDisconnected) {
+        LOG_ERROR("disconnected, give up writing");
+        return;
+    }
+    if (zeroCopy_ && message.size() >= zeroCopyThreshold_) {
+        std::string *owned = new std::string(std::move(message));
+        ReleaseCallback release([owned]() { delete owned; });
+        sendZeroCopyInLoop(owned->data(), owned->size(), release);
+        return;
+    }
     bool faultError = false;
+    struct iovec vec = {&message[0], message.size()};
+    size_t nwrote = sendDirectly(&vec, 1, message.size(), &faultError);
+
+    if (!faultError && nwrote < message.size()) {
+        size_t oldLen = outputBuffer_.readableBytes();
+        outputBuffer_.append(std::move(message), nwrote); // 剩下的直接接管
+        outputQueued(oldLen);
+    }
+}
 
+void TcpConnection::sendBufferInLoop(Buffer &buf) {
     if (state_ == kDisconnected) {
         LOG_ERROR("disconnected, give up writing");
+        return;
+    }
+    if (zeroCopy_ && buf.readableBytes() >= zeroCopyThreshold_) {
+        Buffer *owned = new Buffer(std::move(buf));
+        ReleaseCallback release([owned]() { delete owned; });
+        sendZeroCopyInLoop(owned->peek(), owned->readableBytes(), release);
+        return;
     }
+    bool faultError = false;
+    size_t len = buf.readableBytes();
+    struct iovec vec = {const_cast<char *>(buf.peek()), len};
+    size_t nwrote = sendDirectly(&vec, 1, len, &faultError);
 
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {  
-        nwrote = ::write(channel_->fd(), data, len);
-        if (nwrote >= 0) {
-            remaining = len-nwrote;
-            if (remaining == 0 && writeCompleteCallback_) {
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-            }
-        } else {
-            nwrote = 0;
-            if (errno != EWOULDBLOCK) {
-                LOG_ERROR("TcpConnction::sendInLoop");
-                if (errno == EPIPE || errno == ECONNRESET) {
-                    faultError = true;
-                }
-            }
+    if (!faultError && nwrote < len) {
+        buf.retrieve(nwrote);
+        size_t oldLen = outputBuffer_.readableBytes();
+        outputBuffer_.append(std::move(buf));
+        outputQueued(oldLen);
+    }
+}
+
+void TcpConnection::sendZeroCopyInLoop(const void *data, size_t len, ReleaseCallback &release) {
+    if (!zeroCopy_ || len < zeroCopyThreshold_ || state_ == kDisconnected) {
+        sendInLoop(data, len);
+        if (release) {
+            release(); // 已经拷贝进缓冲区(或者不发了) 调用方的数据可以释放了
         }
+        return;
     }
 
-    //没send完
-    if (!faultError && remaining > 0) {
+    // 零拷贝的数据也按顺序排在输出缓冲区里 前面有数据在排队就等handleWrite发
+    size_t oldLen = outputBuffer_.readableBytes();
+    bool blocked = writingBlocked();
+    outputBuffer_.appendZeroCopy(static_cast<const char *>(data), len, std::move(release));
+    writeAppended(oldLen, blocked);
+}
+
+void TcpConnection::writeAppended(size_t oldLen, bool blocked) {
+    if (!blocked && !autoCork_ && flushOutput()) {
+        return;
+    }
+    outputQueued(oldLen);
+}
+
+bool TcpConnection::flushOutput() {
+    int savedErrno = 0;
+    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+    if (n > 0) {
+        loop_->addTransferred(n);
         size_t oldLen = outputBuffer_.readableBytes();
-        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+        outputBuffer_.retrieve(n);
+        outputRetrieved(oldLen);
+        if (outputBuffer_.readableBytes() == 0) {
+            queueWriteComplete();
+            return true;
+        }
+    } else if (savedErrno != EWOULDBLOCK) {
+        LOG_ERROR("TcpConnection::flushOutput");
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET) {
+            return true; // 数据留在缓冲区里 连接析构时释放
         }
-        outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
-        if (!channel_->isWriting()) {
-            channel_->enableWriting();
+        if (savedErrno == EIO) {
+            forceCloseInLoop(); // 文件被截断 后面的数据已经对不上了
+            return true;
+        }
+    }
+    return false;
+}
+
+void TcpConnection::setTcpNoDelay(bool on) {
+    socket_->setTcpNoDelay(on);
+}
+
+bool TcpConnection::setBusyPoll(int usec, bool prefer) {
+    return socket_->setBusyPoll(usec, prefer);
+}
+
+void TcpConnection::flushCorked() {
+    corkFlushPending_ = false;
+    if (state_ == kDisconnected || outputBuffer_.readableBytes() == 0) {
+        return;
+    }
+    if (flushOutput()) {
+        if (state_ == kDisconnecting) {
+            shutdownInLoop();
+        }
+        return;
+    }
+    // 一次没写完 剩下的交给EPOLLOUT
+    if (!channel_->isWriting()) {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::sendFragmentsInLoop(const StringPiece *fragments, size_t count) {
+    if (state_ == kDisconnected) {
+        LOG_ERROR("disconnected, give up writing");
+        return;
+    }
+    // 一次writev最多IOV_MAX段 再多的后面几段直接进缓冲区
+    int iovcnt = static_cast<int>(std::min<size_t>(count, IOV_MAX));
+    struct iovec inlineVec[16];
+    std::vector<struct iovec> heapVec;
+    struct iovec *vec = inlineVec;
+    if (iovcnt > 16) {
+        heapVec.resize(iovcnt);
+        vec = heapVec.data();
+    }
+    for (int i = 0; i < iovcnt; ++i) {
+        vec[i].iov_base = const_cast<char *>(fragments[i].data());
+        vec[i].iov_len = fragments[i].size();
+    }
+    size_t all = 0;
+    for (size_t i = 0; i < count; ++i) {
+        all += fragments[i].size();
+    }
+
+    bool faultError = false;
+    size_t nwrote = sendDirectly(vec, iovcnt, all, &faultError);
+    if (faultError || nwrote == all) {
+        return;
+    }
+    size_t oldLen = outputBuffer_.readableBytes();
+    for (size_t i = 0; i < count; ++i) {
+        size_t size = fragments[i].size();
+        if (nwrote >= size) {
+            nwrote -= size; // 这一段已经写出去了
+            continue;
+        }
+        outputBuffer_.append(fragments[i].data() + nwrote, size - nwrote);
+        nwrote = 0;
+    }
+    outputQueued(oldLen);
+}
+
+void TcpConnection::startRead() {
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopRead() {
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop() {
+    reading_ = true;
+    if (state_ == kDisconnected) {
+        return;
+    }
+    // 停读期间留在缓冲区里的数据先交给应用 可能因此降到低水位
+    if (inputBuffer_.readableBytes() > 0) {
+        messageCallback_(shared_from_this(), &inputBuffer_, loop_->pollReturnTime());
+        checkInputWaterMarks();
+    }
+    updateReading();
+}
+
+void TcpConnection::stopReadInLoop() {
+    reading_ = false;
+    updateReading();
+}
+
+void TcpConnection::updateReading() {
+    if (state_ == kDisconnected) {
+        return;
+    }
+    bool want = reading_ && !inputPaused_;
+    if (want && !channel_->isReading()) {
+        channel_->enableReading(); // ET下重新注册时内核里已有的数据会再报一次
+    } else if (!want && channel_->isReading()) {
+        channel_->disableReading();
+    }
+}
+
+void TcpConnection::checkInputWaterMarks() {
+    if (state_ == kDisconnected) {
+        return;
+    }
+    size_t len = inputBuffer_.readableBytes();
+    if (!inputPaused_ && len >= inputHighWaterMark_) {
+        inputPaused_ = true;
+        updateReading();
+        if (inputHighWaterMarkCallback_) {
+            loop_->queueInLoop(std::bind(inputHighWaterMarkCallback_, shared_from_this(), len));
+        }
+    } else if (inputPaused_ && len <= inputLowWaterMark_) {
+        inputPaused_ = false;
+        updateReading();
+        if (inputLowWaterMarkCallback_) {
+            loop_->queueInLoop(std::bind(inputLowWaterMarkCallback_, shared_from_this(), len));
         }
     }
 }
@@ -116,19 +487,56 @@ void TcpConnection::shutdown()
 }
 
 void TcpConnection::shutdownInLoop() {
-    if (!channel_->isWriting()) {
+    if (!writingBlocked()) {
         socket_->shutdownWrite();
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
 void TcpConnection::connectEstablished()
 {
     setState(kConnected);
+    loop_->connectionAdded();
     channel_->tie(shared_from_this());
-    channel_->enableReading(); // 向poller注册channel的EPOLLIN读事件
+    channel_->setEdgeTriggered(edgeTriggered_);
+    if (reading_) {
+        channel_->enableReading(); // 向poller注册channel的EPOLLIN读事件
+    }
+    if (edgeTriggered_) {
+        channel_->enableWriting(); // ET模式EPOLLOUT一直注册着 不再反复epoll_ctl
+    }
+    if (zeroCopy_) {
+        // 零拷贝的完成通知只以EPOLLERR报上来 暂停读且没有待发数据时fd也不能从epoll里删掉
+        channel_->enableErrorEvents();
+    }
+    if (idleWheel_)
+    {
+        idleWheel_->add(&idleEntry_, this);
+    }
 
     // 新连接建立 执行回调
     connectionCallback_(shared_from_this());
+
+    if (readOnEstablish_ && state_ == kConnected && channel_->isReading()) {
+        handleRead(Timestamp::now()); // 没数据时readFd返回EAGAIN 什么也不做
+    }
 }
 
 void TcpConnection::connectDestroyed()
@@ -139,43 +547,154 @@ void TcpConnection::connectDestroyed()
         channel_->disableAll(); // 把channel的所有感兴趣的事件从poller中删除掉
         connectionCallback_(shared_from_this());
     }
+    if (idleWheel_)
+    {
+        idleWheel_->remove(&idleEntry_);
+    }
+    loop_->connectionRemoved();
     channel_->remove(); // 把channel从poller中删除掉
+    drainZeroCopy(addTime(MonotonicTime::now(), kZeroCopyDrainTimeout), false);
+}
+
+void TcpConnection::drainZeroCopy(MonotonicTime deadline, bool aborted)
+{
+    if (zeroCopy_) {
+        handleZeroCopyCompletions();
+    }
+    if (outputBuffer_.zeroCopyInflight() == 0) {
+        return;
+    }
+    if (deadline < MonotonicTime::now()) {
+        if (aborted) {
+            // RST之后还没等到 放弃 析构时打日志并泄漏这些数据 不release
+            LOG_ERROR("TcpConnection::drainZeroCopy [%s#%llu] - %zu zero-copy sends still not completed after abort\n",
+                      namePrefix_->c_str(), static_cast<unsigned long long>(id_), outputBuffer_.zeroCopyInflight());
+            return;
+        }
+        // 对端不读 数据一直卡在发送队列里 RST掉让内核放掉这些页
+        LOG_WARN("TcpConnection::drainZeroCopy [%s#%llu] - zero-copy sends not completed in %.0f s, aborting\n",
+                 namePrefix_->c_str(), static_cast<unsigned long long>(id_), kZeroCopyDrainTimeout);
+        socket_->abortConnection();
+        aborted = true;
+        deadline = addTime(MonotonicTime::now(), kZeroCopyAbortGrace);
+    }
+    // 内核还可能重传这些页 用户的内存要等完成通知到了才能释放
+    // 通知只从这个fd的错误队列里来 channel已经摘掉了 定时去取; 定时器持有连接 取完之前socket不会关
+    loop_->runAfter(kZeroCopyDrainInterval,
+                    std::bind(&TcpConnection::drainZeroCopy, shared_from_this(), deadline, aborted));
 }
 
 //对于Server服务器
 void TcpConnection::handleRead(Timestamp receiveTime) {
+    if (edgeTriggered_) {
+        handleReadEdgeTriggered(receiveTime);
+        return;
+    }
     int savedErrno = 0;
     ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
     if (n>0) {
+        loop_->addTransferred(n);
+        if (idleWheel_) {
+            idleWheel_->touch(&idleEntry_);
+        }
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        checkInputWaterMarks();
     } else if (n == 0) {
         handleClose();
-    } else {
+    } else if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) {
         errno = savedErrno;
         LOG_ERROR("TcpConnection::handleRead");
         handleError();
     }
 }
 
+// ET: 一直读到EAGAIN 读够readBudget_还没读完就让出 本轮pending functors里接着读
+void TcpConnection::handleReadEdgeTriggered(Timestamp receiveTime) {
+    if (state_ == kDisconnected || !channel_->isReading()) {
+        return; // 排队接着读之前被stopRead或者水位暂停了
+    }
+    size_t total = 0;
+    int savedErrno = 0;
+    bool drained = false;
+    bool peerClosed = false;
+    bool error = false;
+    while (total < readBudget_ && inputBuffer_.readableBytes() < inputHighWaterMark_) {
+        ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+        if (n > 0) {
+            total += n;
+        } else if (n == 0) {
+            peerClosed = true;
+            break;
+        } else if (savedErrno == EINTR) {
+            continue;
+        } else {
+            drained = (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK);
+            error = !drained;
+            break;
+        }
+    }
+
+    if (total > 0) {
+        loop_->addTransferred(total);
+        if (idleWheel_) {
+            idleWheel_->touch(&idleEntry_);
+        }
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        checkInputWaterMarks();
+    }
+    if (peerClosed) {
+        handleClose();
+    } else if (error) {
+        errno = savedErrno;
+        LOG_ERROR("TcpConnection::handleRead");
+        handleError();
+    } else if (!drained && state_ != kDisconnected && channel_->isReading()) {
+        // 内核里还有数据 ET不会再通知 自己排队接着读
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::handleReadEdgeTriggered, shared_from_this(), receiveTime));
+    }
+}
+
 void TcpConnection::handleWrite() {
     if (channel_->isWriting()) {
         int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
-        if (n > 0) {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) {
-                channel_->disableWriting();
-                if (writeCompleteCallback_) {
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        bool wrote = false;
+        // LT写一次 没写完等下一次EPOLLOUT; ET一直写到缓冲区空或者EAGAIN
+        while (outputBuffer_.readableBytes() > 0) {
+            ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+            if (n <= 0) {
+                if (!edgeTriggered_ || saveErrno != EWOULDBLOCK) {
+                    LOG_ERROR("TcpConnection::handleWrite");
                 }
-                if (state_ == kDisconnected) {
-                    shutdownInLoop();
+                if (saveErrno == EIO) {
+                    forceCloseInLoop(); // 文件被截断 后面的数据已经对不上了
+                    return;
                 }
+                break;
+            }
+            wrote = true;
+            loop_->addTransferred(n);
+            size_t oldLen = outputBuffer_.readableBytes();
+            outputBuffer_.retrieve(n);
+            outputRetrieved(oldLen);
+            if (!edgeTriggered_) {
+                break;
             }
-        } else {
-            LOG_ERROR("TcpConnection::handleWrite");
         }
-    } else {
+        if (wrote && idleWheel_) {
+            idleWheel_->touch(&idleEntry_);
+        }
+        if (wrote && outputBuffer_.readableBytes() == 0) {
+            if (!edgeTriggered_) {
+                channel_->disableWriting();
+            }
+            queueWriteComplete();
+            if (state_ == kDisconnecting) {
+                shutdownInLoop();
+            }
+        }
+    } else if (state_ != kDisconnected) {
+        // 同一次事件里读回调已经关闭了连接(ET下EPOLLIN和EPOLLOUT经常一起来) 不算错误
         LOG_ERROR("TcpConnection fd=%d is down, no more writing", channel_->fd());
     }
 }
@@ -185,14 +704,21 @@ void TcpConnection::handleClose()
     LOG_INFO("TcpConnection::handleClose fd=%d state=%d\n", channel_->fd(), (int)state_);
     setState(kDisconnected);
     channel_->disableAll();
+    if (idleWheel_) {
+        idleWheel_->remove(&idleEntry_);
+    }
 
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr); // 连接回调
-    closeCallback_(connPtr);      // 执行关闭连接的回调 执行的是TcpServer::removeConnection回调方法   // must be the last line
+    closeCallback_(connPtr);      // 执行关闭连接的回调 TcpServer在这里把连接从所属loop的连接表里移除   // must be the last line
 }
 
 void TcpConnection::handleError()
 {
+    if (zeroCopy_) {
+        // 零拷贝的完成通知也是通过EPOLLERR报上来的 不是真的出错
+        handleZeroCopyCompletions();
+    }
     int optval;
     socklen_t optlen = sizeof optval;
     int err = 0;
@@ -204,7 +730,49 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d\n", name_.c_str(), err);
+    if (err != 0 || !zeroCopy_)
+    {
+        LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d\n", name().c_str(), err);
+    }
+}
+
+void TcpConnection::handleZeroCopyCompletions()
+{
+    char control[128];
+    for (;;)
+    {
+        struct msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        if (::recvmsg(channel_->fd(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            break; // EAGAIN 错误队列读空了
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            bool recvErr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                           (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recvErr)
+            {
+                continue;
+            }
+            const struct sock_extended_err *serr = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+            // [ee_info, ee_data]这一段发送内核都用完了
+            uint32_t lo = serr->ee_info;
+            uint32_t hi = serr->ee_data;
+            int64_t count = static_cast<uint32_t>(hi - lo) + 1;
+            zeroCopyCompletions_ += count;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                zeroCopyCopied_ += count; // 内核最后还是拷贝了 回环上总是这样
+            }
+            outputBuffer_.zeroCopyCompleted(lo, hi);
+        }
+    }
 }
 
 void TcpConnection::sendFile(int fileDescriptor, off_t offset, size_t count) {
@@ -221,34 +789,13 @@ void TcpConnection::sendFile(int fileDescriptor, off_t offset, size_t count) {
 }
 
 void TcpConnection::sendFileInLoop(int fileDescriptor, off_t offset, size_t count) {
-    ssize_t bytesSent = 0;
-    size_t remaining = count;
-    bool faultError = false;
-
-    if (state_ == kDisconnecting) {
+    if (state_ == kDisconnected) {
         LOG_ERROR("disconnected, give up writing");
         return;
     }
-
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-        bytesSent = sendfile(socket_->fd(), fileDescriptor, &offset, count);
-        if (bytesSent >= 0) {
-            remaining -= bytesSent;
-            if (remaining == 0 && writeCompleteCallback_) {
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-            } 
-        } else {
-            if (errno != EWOULDBLOCK) {
-                LOG_ERROR("TcpConnection::sendFileInLoop");
-            }
-            if (errno == EPIPE || errno == ECONNRESET) {
-                faultError = true;
-            }
-        }
-    }
-
-    //剩余没发完的数据，要enablewriting,
-    if (!faultError && remaining > 0) {
-        loop_->queueInLoop(std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fileDescriptor, offset, remaining));
-    }
+    // 文件段和内存数据排在同一个输出队列里 前面的数据发完才轮到它 由handleWrite在EPOLLOUT时继续sendfile
+    size_t oldLen = outputBuffer_.readableBytes();
+    bool blocked = writingBlocked();
+    outputBuffer_.appendFile(fileDescriptor, offset, count);
+    writeAppended(oldLen, blocked);
 }
\ No newline at end of file
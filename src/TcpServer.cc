@@ -1,5 +1,8 @@
 #include <functional>
+#include <future>
 #include <string.h>
+#include <unistd.h>
+#include <linux/filter.h>
 
 #include "TcpServer.h"
 #include "Logger.h"
@@ -17,33 +20,70 @@ TcpServer::TcpServer(EventLoop *loop,
                      const std::string &nameArg,
                      Option option)
     : loop_(loop)
+    , listenAddr_(listenAddr)
     , ipPort_(listenAddr.toIpPort())
     , name_(nameArg)
-    , acceptor_(std::make_unique<Acceptor>(loop, listenAddr, option==KReusePort))
+    , connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_))
+    , acceptor_(std::make_unique<Acceptor>(loop, listenAddr, option != kNoReusePort))
+    , perLoopAccept_(option == kReusePortPerLoop)
+    , acceptSteering_(kHashSteering)
     , threadPool_(std::make_shared<EventLoopThreadPool>(loop, name_))
     , connectionCallback_()
     , messageCallback_()
-    , nextConnId_(1)
+    , numThreads_(0)
     , started_(0) 
+    , nextConnId_(1)
+    , idleTimeout_(0.0)
+    , idleTick_(1.0)
+    , edgeTriggered_(false)
+    , readBudget_(1024 * 1024)
+    , zeroCopy_(false)
+    , zeroCopyThreshold_(TcpConnection::kDefaultZeroCopyThreshold)
+    , autoCork_(false)
+    , acceptBatch_(Acceptor::kDefaultAcceptBatch)
+    , maxConnections_(0)
+    , deferAcceptSeconds_(0)
+    , fastOpenQueue_(0)
+    , busyPollSpinUs_(0)
+    , busyPollAdaptive_(true)
+    , socketBusyPollUs_(0)
 {
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
 }
 
 TcpServer::~TcpServer()
 {
-    for(auto &item : connections_)
+    if (limit_)
     {
-        TcpConnectionPtr conn(item.second);
-        item.second.reset();    // 把原始的智能指针复位 让栈空间的TcpConnectionPtr conn指向该对象 当conn出了其作用域 即可释放智能指针指向的对象
-        // 销毁连接
-        conn->getLoop()->runInLoop(
-            std::bind(&TcpConnection::connectDestroyed, conn));
+        limit_->server = nullptr; // 还没执行的恢复accept回调看到这个就不做了
+    }
+    // 每个loop的Acceptor要在自己线程里从poller上摘掉 等它摘完 之后不会再有新连接回调进来
+    for (size_t i = 0; i < loopAcceptors_.size(); ++i)
+    {
+        std::promise<void> removed;
+        Acceptor *acceptor = loopAcceptors_[i].release();
+        threadPool_->getAllLoops()[i]->runInLoop([acceptor, &removed]() {
+            delete acceptor;
+            removed.set_value();
+        });
+        removed.get_future().wait();
+    }
+    // 每个loop在自己的线程里销毁自己的连接
+    for (auto &item : shards_)
+    {
+        ShardPtr shard(item.second);
+        item.first->runInLoop([shard]() {
+            for (const TcpConnectionPtr &conn : shard->connections.takeAll())
+            {
+                conn->connectDestroyed();
+            }
+        });
     }
 }
 
 void TcpServer::setThreadNum(int numThreads)
 {
-    int numThreads_=numThreads;
+    numThreads_ = numThreads;
     threadPool_->setThreadNum(numThreads_);
 }
 
@@ -52,19 +92,204 @@ void TcpServer::start()
     if (started_.fetch_add(1) == 0)    // 防止一个TcpServer对象被start多次
     {
         threadPool_->start(threadInitCallback_);    // 启动底层的loop线程池
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        if (busyPollSpinUs_ > 0)
+        {
+            // 只给IO loop开 只有baseloop时才给它开
+            int64_t spin = busyPollSpinUs_;
+            bool adaptive = busyPollAdaptive_;
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                ioLoop->runInLoop([ioLoop, spin, adaptive]() { ioLoop->setBusyPoll(spin, adaptive); });
+            }
+        }
+        if (maxConnections_ > 0)
+        {
+            limit_ = std::make_shared<ConnectionLimit>();
+            limit_->connections.store(0);
+            limit_->maxConnections = maxConnections_;
+            limit_->baseLoop = loop_;
+            limit_->server = this;
+        }
+        if (idleTimeout_ > 0.0)
+        {
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                std::shared_ptr<TimingWheel> wheel = std::make_shared<TimingWheel>(ioLoop, idleTimeout_, idleTick_);
+                wheel->start();
+                idleWheels_[ioLoop] = wheel;
+            }
+        }
+        // 监听socket先设置好(还不listen) 新连接建立时要不要直接读看TCP_DEFER_ACCEPT/TFO有没有设置成功
+        bool perLoopAccept = perLoopAccept_ && numThreads_ > 0;
+        bool readOnEstablish = perLoopAccept ? createLoopAcceptors() : setupListenSocket(acceptor_.get());
+        std::shared_ptr<ConnectionOptions> options(std::make_shared<ConnectionOptions>());
+        options->namePrefix = connNamePrefix_;
+        options->connectionCallback = connectionCallback_;
+        options->messageCallback = messageCallback_;
+        options->writeCompleteCallback = writeCompleteCallback_;
+        options->edgeTriggered = edgeTriggered_;
+        options->readBudget = readBudget_;
+        options->zeroCopy = zeroCopy_;
+        options->zeroCopyThreshold = zeroCopyThreshold_;
+        options->autoCork = autoCork_;
+        options->readOnEstablish = readOnEstablish;
+        options->socketBusyPollUs = socketBusyPollUs_;
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            ShardPtr shard(std::make_shared<ConnectionShard>());
+            shard->loop = ioLoop;
+            shard->limit = limit_;
+            shard->options = options;
+            if (!idleWheels_.empty())
+            {
+                shard->idleWheel = idleWheels_.at(ioLoop);
+            }
+            shards_[ioLoop] = shard;
+        }
+        if (perLoopAccept)
+        {
+            listenLoopAcceptors();
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
+    }
+}
+
+bool TcpServer::createLoopAcceptors()
+{
+    bool readOnEstablish = true;
+    for (EventLoop *ioLoop : threadPool_->getAllLoops())
+    {
+        Acceptor *acceptor = new Acceptor(ioLoop, listenAddr_, true);
+        readOnEstablish = setupListenSocket(acceptor) && readOnEstablish;
+        acceptor->setNewConnectionCallback(
+            std::bind(&TcpServer::newLoopConnection, this, acceptor, ioLoop, std::placeholders::_1, std::placeholders::_2));
+        loopAcceptors_.emplace_back(acceptor);
     }
+    return readOnEstablish;
+}
+
+void TcpServer::listenLoopAcceptors()
+{
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        // 按顺序一个个listen 监听socket在reuseport组里的下标就和loop的下标一致 CBPF程序靠这个下标选loop
+        Acceptor *acceptor = loopAcceptors_[i].get();
+        std::promise<void> listening;
+        loops[i]->runInLoop([acceptor, &listening]() {
+            acceptor->listen();
+            listening.set_value();
+        });
+        listening.get_future().wait();
+    }
+
+    if (acceptSteering_ == kCpuSteering)
+    {
+        struct sock_filter code[] = {
+            {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)}, // A = 当前CPU
+            {BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(loops.size())},        // A %= loop数
+            {BPF_RET | BPF_A, 0, 0, 0},                                                      // 返回监听socket下标
+        };
+        loopAcceptors_[0]->socket()->attachReusePortCbpf(code, sizeof code / sizeof code[0]);
+    }
+}
+
+// listen之前调用
+bool TcpServer::setupListenSocket(Acceptor *acceptor)
+{
+    acceptor->setAcceptBatch(acceptBatch_);
+    bool readOnEstablish = false;
+    if (deferAcceptSeconds_ > 0)
+    {
+        if (acceptor->socket()->setDeferAccept(deferAcceptSeconds_))
+        {
+            readOnEstablish = true;
+        }
+        else
+        {
+            LOG_ERROR("TcpServer::setupListenSocket [%s] - TCP_DEFER_ACCEPT not set, accepting without it\n", name_.c_str());
+        }
+    }
+    if (fastOpenQueue_ > 0)
+    {
+        if (acceptor->socket()->setFastOpen(fastOpenQueue_))
+        {
+            readOnEstablish = true;
+        }
+        else
+        {
+            LOG_ERROR("TcpServer::setupListenSocket [%s] - TCP_FASTOPEN not set, accepting without it\n", name_.c_str());
+        }
+    }
+    return readOnEstablish;
 }
 
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr) {
-    EventLoop* ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
-
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s\n",
-             name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+    if (admitConnection(acceptor_.get(), sockfd))
+    {
+        createConnection(threadPool_->getLoopForConnection(peerAddr), sockfd, peerAddr);
+    }
+}
+
+void TcpServer::newLoopConnection(Acceptor *acceptor, EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    if (admitConnection(acceptor, sockfd))
+    {
+        createConnection(ioLoop, sockfd, peerAddr);
+    }
+}
+
+bool TcpServer::admitConnection(Acceptor *acceptor, int sockfd)
+{
+    if (!limit_)
+    {
+        return true;
+    }
+    int connections = limit_->connections.fetch_add(1) + 1;
+    if (connections > limit_->maxConnections)
+    {
+        // 每个loop自己accept时 别的loop刚好先占满了
+        limit_->connections.fetch_sub(1);
+        ::close(sockfd);
+        acceptor->pause();
+        LOG_WARN("TcpServer::admitConnection [%s] - over %d connections, connection dropped\n",
+                 name_.c_str(), limit_->maxConnections);
+        return false;
+    }
+    if (connections == limit_->maxConnections)
+    {
+        acceptor->pause();
+        LOG_INFO("TcpServer::admitConnection [%s] - reached %d connections, accept paused\n",
+                 name_.c_str(), limit_->maxConnections);
+    }
+    return true;
+}
+
+void TcpServer::resumeAccepting()
+{
+    if (loopAcceptors_.empty())
+    {
+        acceptor_->resume();
+        return;
+    }
+    // 析构时删除这些Acceptor的回调排在后面 这里投递的先执行
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    for (size_t i = 0; i < loopAcceptors_.size(); ++i)
+    {
+        Acceptor *acceptor = loopAcceptors_[i].get();
+        loops[i]->runInLoop([acceptor]() { acceptor->resume(); });
+    }
+}
+
+void TcpServer::createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr) {
+    uint64_t connId = nextConnId_.fetch_add(1, std::memory_order_relaxed);
+
+    // 名字要用的时候才拼 INFO关掉时下面的参数不会求值
+    LOG_INFO("TcpServer::newConnection [%s] - new connection #%llu from %s\n",
+             name_.c_str(), static_cast<unsigned long long>(connId), peerAddr.toIpPort().c_str());
     
     // 通过sockfd获取其绑定的本机的ip地址和端口信息
     sockaddr_in local;
@@ -73,39 +298,69 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr) {
     if(::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0) {
         LOG_ERROR("sockets::getLocalAddr");
     }
-
     InetAddress localAddr(local);
-    TcpConnectionPtr conn(new TcpConnection(ioLoop,
-                                        connName,
+
+    // 连接对象到ioLoop线程里再构造 每个loop自己accept时已经在ioLoop线程里了 直接建立
+    ioLoop->runInLoop(
+        std::bind(&TcpServer::newConnectionInLoop, shards_.at(ioLoop), connId, sockfd, localAddr, peerAddr));
+}
+
+void TcpServer::newConnectionInLoop(const ShardPtr &shard, uint64_t connId, int sockfd,
+                                    const InetAddress &localAddr, const InetAddress &peerAddr)
+{
+    const ConnectionOptions &options = *shard->options;
+    TcpConnectionPtr conn(new TcpConnection(shard->loop,
+                                        connId,
+                                        options.namePrefix,
                                         sockfd,
                                         localAddr,
                                         peerAddr));
-    connections_[connName] = conn;
     
     // 下面的回调都是用户设置给TcpServer => TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，handleRead,handleWrite... 这下面的回调用于handlexxx函数中
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
-    conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
-
-    ioLoop->runInLoop(
-        std::bind(&TcpConnection::connectEstablished, conn));
+    conn->setConnectionCallback(options.connectionCallback);
+    conn->setMessageCallback(options.messageCallback);
+    conn->setWriteCompleteCallback(options.writeCompleteCallback);
+    conn->setEdgeTriggered(options.edgeTriggered, options.readBudget);
+    if (options.zeroCopy)
+    {
+        conn->setZeroCopy(true, options.zeroCopyThreshold);
+    }
+    conn->setAutoCork(options.autoCork);
+    conn->setReadOnEstablish(options.readOnEstablish);
+    if (options.socketBusyPollUs > 0)
+    {
+        conn->setBusyPoll(options.socketBusyPollUs);
+    }
+    if (shard->idleWheel)
+    {
+        conn->setIdleWheel(shard->idleWheel.get());
+    }
+    connectEstablishedInLoop(shard, conn);
 }
 
-
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+void TcpServer::connectEstablishedInLoop(const ShardPtr &shard, const TcpConnectionPtr &conn)
 {
-    loop_->runInLoop(
-        std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    uint32_t slot = shard->connections.insert(conn);
+    conn->setCloseCallback([shard, slot](const TcpConnectionPtr &closed) {
+        // 已经在所属loop里了 从表里拿出来 本轮末尾销毁(handleEvent还在用这个连接的Channel)
+        TcpConnectionPtr *entry = shard->connections.get(slot);
+        if (entry == nullptr || *entry != closed)
+        {
+            return; // TcpServer析构时已经整体移除了
+        }
+        TcpConnectionPtr owned(shard->connections.take(slot));
+        closed->getLoop()->queueInLoop(std::bind(&TcpConnection::connectDestroyed, std::move(owned)));
+        const LimitPtr &limit = shard->limit;
+        if (limit && limit->connections.fetch_sub(1) == limit->maxConnections)
+        {
+            // 从上限降下来 回baseloop恢复accept
+            limit->baseLoop->queueInLoop([limit]() {
+                if (limit->server != nullptr)
+                {
+                    limit->server->resumeAccepting();
+                }
+            });
+        }
+    });
+    conn->connectEstablished();
 }
-
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
-{
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
-             name_.c_str(), conn->name().c_str());
-
-    connections_.erase(conn->name());
-    EventLoop *ioLoop = conn->getLoop();
-    ioLoop->queueInLoop(
-        std::bind(&TcpConnection::connectDestroyed, conn));
-}
\ No newline at end of file
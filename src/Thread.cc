@@ -1,11 +1,12 @@
 #include "Thread.h"
 #include "CurrentThread.h"
+#include "ThreadPlacement.h"
 
 #include <semaphore.h>
 
 std::atomic_int Thread::numCreated_(0);  //() {} 是调用构造函数赋值
 
-Thread::Thread(ThreadFunc func, const std::string &name = std::string())
+Thread::Thread(ThreadFunc func, const std::string &name)
     : started_(false)
     , joined_(false)
     , name_(name)
@@ -28,6 +29,7 @@ void Thread::start() {
 
     thread_ = std::shared_ptr<std::thread>(new std::thread([&]() {
         tid_ = CurrentThread::tid();                                  
+        ThreadPlacement::setCurrentThreadName(name_);
         sem_post(&sem);
         func_();   
     }));
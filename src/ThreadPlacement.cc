@@ -0,0 +1,120 @@
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <algorithm>
+
+#include "ThreadPlacement.h"
+#include "Logger.h"
+
+namespace ThreadPlacement
+{
+    bool pinCurrentThread(int cpu)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (::sched_setaffinity(0, sizeof set, &set) < 0)
+        {
+            LOG_WARN("ThreadPlacement::pinCurrentThread cpu=%d errno=%d\n", cpu, errno);
+            return false;
+        }
+        return true;
+    }
+
+    bool preferMemoryNode(int node)
+    {
+        // 不依赖libnuma 直接调set_mempolicy
+        unsigned long mask[16] = {0};
+        const unsigned long kBits = sizeof(unsigned long) * 8;
+        if (node < 0 || node >= static_cast<int>(sizeof mask * 8))
+        {
+            return false;
+        }
+        mask[node / kBits] = 1UL << (node % kBits);
+        if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof mask * 8) < 0)
+        {
+            LOG_WARN("ThreadPlacement::preferMemoryNode node=%d errno=%d\n", node, errno);
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<int> nodeCpus(int node)
+    {
+        std::vector<int> cpus;
+        char path[64];
+        snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *fp = ::fopen(path, "r");
+        if (fp == nullptr)
+        {
+            return cpus;
+        }
+        // 格式: 0-3,8-11
+        int first = 0;
+        while (::fscanf(fp, "%d", &first) == 1)
+        {
+            int last = first;
+            int c = ::fgetc(fp);
+            if (c == '-')
+            {
+                if (::fscanf(fp, "%d", &last) != 1)
+                {
+                    break;
+                }
+                c = ::fgetc(fp);
+            }
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+            if (c != ',')
+            {
+                break;
+            }
+        }
+        ::fclose(fp);
+        return cpus;
+    }
+
+    int cpuNode(int cpu)
+    {
+        // /sys/devices/system/cpu/cpuN/下有一个nodeX的链接
+        char path[64];
+        snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d", cpu);
+        DIR *dir = ::opendir(path);
+        if (dir == nullptr)
+        {
+            return -1;
+        }
+        int node = -1;
+        while (struct dirent *entry = ::readdir(dir))
+        {
+            if (::sscanf(entry->d_name, "node%d", &node) == 1)
+            {
+                break;
+            }
+            node = -1;
+        }
+        ::closedir(dir);
+        return node;
+    }
+
+    void setCurrentThreadName(const std::string &name)
+    {
+        // 内核限制16字节(含结尾的0) 太长时截前缀 保留末尾的编号(线程池里是loop下标)
+        const size_t kMaxLength = 15;
+        std::string shortName(name);
+        if (shortName.size() > kMaxLength)
+        {
+            size_t digits = shortName.size() - shortName.find_last_not_of("0123456789") - 1;
+            digits = std::min(digits, kMaxLength);
+            shortName = name.substr(0, kMaxLength - digits) + name.substr(name.size() - digits);
+        }
+        ::pthread_setname_np(::pthread_self(), shortName.c_str());
+    }
+}
@@ -11,26 +11,49 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 {
 }
 
+// clock_gettime走vDSO 不陷入内核
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
 }
+
 std::string Timestamp::toString() const
+{
+    return toFormattedString(false);
+}
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
 {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-             tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1,
-             tm_time->tm_mday,
-             tm_time->tm_hour,
-             tm_time->tm_min,
-             tm_time->tm_sec);
+    time_t seconds = secondsSinceEpoch();
+    struct tm tm_time;
+    ::localtime_r(&seconds, &tm_time); // localtime返回静态对象 多线程不安全
+    int len = snprintf(buf, sizeof buf, "%4d/%02d/%02d %02d:%02d:%02d",
+                       tm_time.tm_year + 1900,
+                       tm_time.tm_mon + 1,
+                       tm_time.tm_mday,
+                       tm_time.tm_hour,
+                       tm_time.tm_min,
+                       tm_time.tm_sec);
+    if (showMicroseconds)
+    {
+        int microseconds = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        snprintf(buf + len, sizeof buf - len, ".%06d", microseconds);
+    }
     return buf;
 }
 
+MonotonicTime MonotonicTime::now()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return MonotonicTime(static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
 // #include <iostream>
 // int main() {
 //     std::cout << Timestamp::now().toString() << std::endl;
 //     return 0;
-// }
\ No newline at end of file
+// }
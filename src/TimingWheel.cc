@@ -0,0 +1,119 @@
+#include <math.h>
+#include <memory>
+
+#include "TimingWheel.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+TimingWheel::TimingWheel(EventLoop *loop, double idleSeconds, double tickSeconds)
+    : loop_(loop)
+    , tickSeconds_(tickSeconds)
+    , idleTicks_(std::max<int64_t>(1, static_cast<int64_t>(ceil(idleSeconds / tickSeconds))))
+    , buckets_(idleTicks_ + 1) // 多一格 保证刚touch过的连接不会落在当前槽
+    , currentTick_(0)
+    , size_(0)
+{
+    for (Entry &head : buckets_)
+    {
+        head.prev = &head;
+        head.next = &head;
+    }
+}
+
+TimingWheel::~TimingWheel()
+{
+    // 剩下的连接由TcpServer负责销毁 这里只把节点摘下来
+    for (Entry &head : buckets_)
+    {
+        while (head.next != &head)
+        {
+            unlink(head.next);
+        }
+    }
+}
+
+void TimingWheel::start()
+{
+    std::weak_ptr<TimingWheel> weakWheel(shared_from_this());
+    loop_->runEvery(tickSeconds_, [weakWheel]() {
+        std::shared_ptr<TimingWheel> wheel = weakWheel.lock();
+        if (wheel)
+        {
+            wheel->onTick();
+        }
+    });
+}
+
+void TimingWheel::add(Entry *entry, TcpConnection *conn)
+{
+    if (entry->linked())
+    {
+        return;
+    }
+    entry->conn = conn;
+    entry->lastActiveTick = currentTick_;
+    link(entry, currentTick_ + idleTicks_);
+    ++size_;
+}
+
+void TimingWheel::remove(Entry *entry)
+{
+    if (entry->linked())
+    {
+        unlink(entry);
+        --size_;
+    }
+}
+
+void TimingWheel::onTick()
+{
+    ++currentTick_;
+    Entry &head = buckets_[currentTick_ % buckets_.size()];
+
+    // 先把超时的连接收集起来 再统一关闭 关闭回调里会remove节点
+    std::vector<TcpConnectionPtr> expired;
+    Entry *entry = head.next;
+    while (entry != &head)
+    {
+        Entry *next = entry->next;
+        int64_t deadline = entry->lastActiveTick + idleTicks_;
+        unlink(entry);
+        if (deadline <= currentTick_)
+        {
+            --size_;
+            expired.push_back(entry->conn->shared_from_this());
+        }
+        else
+        {
+            link(entry, deadline); // 中途活跃过 挪到新的到期槽
+        }
+        entry = next;
+    }
+
+    if (!expired.empty())
+    {
+        LOG_INFO("TimingWheel::onTick evict %lu idle connections\n", expired.size());
+    }
+    for (const TcpConnectionPtr &conn : expired)
+    {
+        conn->forceClose();
+    }
+}
+
+void TimingWheel::link(Entry *entry, int64_t deadlineTick)
+{
+    Entry &head = buckets_[deadlineTick % buckets_.size()];
+    entry->prev = head.prev;
+    entry->next = &head;
+    head.prev->next = entry;
+    head.prev = entry;
+}
+
+void TimingWheel::unlink(Entry *entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->prev = nullptr;
+    entry->next = nullptr;
+}